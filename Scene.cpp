@@ -5,16 +5,357 @@
 #include <fstream>
 #include <cmath>
 #include <map>
+#include <cfloat>
+#include <algorithm>
 
 #include "Scene.h"
 #include "mat4.hpp"
 #include "tinyxml2.h"
+#include "xml_stream.hpp"
+#include "tokenizer.hpp"
+#include "rscene.hpp"
+#include "image.hpp"
+#include "obj.hpp"
+#include "ply.hpp"
+#include "transform.hpp"
 
 using namespace tinyxml2;
 
 class ParseError {};
 
+#define FACES_CHUNK_SIZE (1 << 20) // bytes of <Faces> text parsed per task
+
+static void compute_bounds(Mesh& mesh)
+{
+	mesh.bounds_min = vec4{ DBL_MAX, DBL_MAX, DBL_MAX, 1 };
+	mesh.bounds_max = vec4{ -DBL_MAX, -DBL_MAX, -DBL_MAX, 1 };
+	for (auto& coord : mesh.positions)
+	{
+		mesh.bounds_min = min4(mesh.bounds_min, coord);
+		mesh.bounds_max = max4(mesh.bounds_max, coord);
+	}
+
+	//centered on the box, which is within a few percent of the minimal sphere for typical meshes
+	vec4 center = (mesh.bounds_min + mesh.bounds_max) * 0.5;
+	double radius_sq = 0;
+	for (auto& coord : mesh.positions)
+	{
+		vec4 d = coord - center;
+		radius_sq = std::max(radius_sq, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	}
+	mesh.bounds_sphere = center;
+	mesh.bounds_sphere[3] = std::sqrt(radius_sq);
+}
+
+static void compute_face_planes(Mesh& mesh)
+{
+	size_t count = mesh.triangle_count();
+	std::vector<double> planes(4 * count);
+	for (size_t i = 0; i < count; i++)
+	{
+		Triangle tri = mesh.get_triangle(i);
+		vec4 normal = get_triangle_normal(tri), center = get_triangle_center(tri);
+		planes[i] = normal[0];
+		planes[count + i] = normal[1];
+		planes[2 * count + i] = normal[2];
+		planes[3 * count + i] = normal[0] * center[0] + normal[1] * center[1] + normal[2] * center[2];
+	}
+	mesh.face_planes = Array<double>(std::move(planes));
+}
+
+// meshlets are runs of consecutive triangles, which the mesh formats keep
+// spatially close for any real model
+static void compute_meshlets(Mesh& mesh)
+{
+	size_t count = mesh.triangle_count();
+	size_t meshlet_count = (count + MESHLET_SIZE - 1) / MESHLET_SIZE;
+	const double* planes = mesh.face_planes.data();
+	std::vector<vec4> spheres(meshlet_count), cones(meshlet_count);
+
+	for (size_t m = 0; m < meshlet_count; m++)
+	{
+		size_t first = m * MESHLET_SIZE, last = std::min(first + MESHLET_SIZE, count);
+
+		vec4 lo = vec4{ DBL_MAX, DBL_MAX, DBL_MAX, 1 }, hi = vec4{ -DBL_MAX, -DBL_MAX, -DBL_MAX, 1 };
+		for (size_t i = 3 * first; i < 3 * last; i++)
+		{
+			lo = min4(lo, mesh.positions[mesh.indices[i]]);
+			hi = max4(hi, mesh.positions[mesh.indices[i]]);
+		}
+		vec4 center = (lo + hi) * 0.5;
+		double radius_sq = 0;
+		for (size_t i = 3 * first; i < 3 * last; i++)
+		{
+			vec4 d = mesh.positions[mesh.indices[i]] - center;
+			radius_sq = std::max(radius_sq, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		}
+		spheres[m] = center;
+		spheres[m][3] = std::sqrt(radius_sq);
+
+		//degenerate triangles never pass the perspective backface test and are left out of the cone
+		vec4 axis = vec4{ 0, 0, 0, 0 };
+		bool valid = true;
+		for (size_t i = first; i < last; i++)
+		{
+			vec4 normal = vec4{ planes[i], planes[count + i], planes[2 * count + i], 0 };
+			double length = std::sqrt(dot4(normal, normal));
+			if (length > 0)
+				axis += normal / length;
+			else if (!(length == 0))
+				valid = false;
+		}
+		double axis_length = std::sqrt(dot4(axis, axis));
+		if (!(axis_length > 0))
+			valid = false;
+		axis /= axis_length;
+
+		double min_cos = 1;
+		for (size_t i = first; i < last; i++)
+		{
+			vec4 normal = vec4{ planes[i], planes[count + i], planes[2 * count + i], 0 };
+			double length = std::sqrt(dot4(normal, normal));
+			if (length > 0)
+				min_cos = std::min(min_cos, dot4(normal, axis) / length);
+		}
+		cones[m] = axis;
+		cones[m][3] = valid ? min_cos : -1;
+	}
+
+	mesh.meshlet_spheres = Array<vec4>(std::move(spheres));
+	mesh.meshlet_cones = Array<vec4>(std::move(cones));
+}
+
+// picks the importer from the extension of filename
+static bool load_mesh_file(const std::string& filename, vec4c default_color, MeshData& data)
+{
+	std::string extension = get_extension(filename);
+	if (extension == "obj")
+		return load_obj(filename, default_color, data);
+	if (extension == "ply")
+		return load_ply(filename, default_color, data);
+	return false;
+}
+
+// mesh files are looked up relative to the scene file
+static std::string resolve_path(const char *scenePath, const char *filename)
+{
+	std::string scene = scenePath;
+	size_t slash = scene.find_last_of("/\\");
+	if (slash == std::string::npos || filename[0] == '/' || filename[0] == '\\' || strchr(filename, ':') != NULL)
+		return filename;
+	return scene.substr(0, slash + 1) + filename;
+}
+
+// Faces of one <Mesh> as read from the file, not yet indexed
+struct MeshSource
+{
+	RenderType type;
+	mat4 transformation;
+	std::vector< std::vector<int> > faces; // consecutive chunks of 1-based vertex ids, three per face
+	std::string file; // OBJ or PLY file used instead of the faces, empty when there is none
+	vec4 color = vec4{ 255, 255, 255, 255 }; // for vertices of file that have no color
+};
+
+// Faces text is cut into chunks at line breaks, each chunk holding whole faces
+struct FacesChunk
+{
+	size_t mesh, part;
+	const char *first, *last;
+};
+
+// Parses the chunks in parallel, in place three vertex ids at a time, into the
+// faces of their meshes. false when a chunk is not a list of whole faces
+static bool parse_faces(const std::vector<FacesChunk>& chunks, std::vector<MeshSource>& sources)
+{
+	bool failed = false;
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int)chunks.size(); i++)
+	{
+		const char *first = chunks[i].first;
+		auto& ids = sources[chunks[i].mesh].faces[chunks[i].part];
+		int face[3];
+		int count;
+
+		while ((count = parse_numbers(first, chunks[i].last, face, 3)) == 3)
+			ids.insert(ids.end(), face, face + 3);
+
+		if (count != 0 || skip_whitespace(first, chunks[i].last) != chunks[i].last)
+		{
+			#pragma omp atomic write
+			failed = true;
+		}
+	}
+	return !failed;
+}
+
+// Turns faces given in 1-based global vertex ids into an indexed mesh, with
+// vertices in order of first use. The remap covers only the ids the mesh
+// references, so its size follows the mesh rather than the scene.
+// false when an id does not name a vertex
+static bool build_indexed_mesh(const std::vector< std::vector<int> >& faces, const std::vector< std::pair<vec4,vec4> >& v, MeshData& data)
+{
+	std::vector<int> ids;
+	for (auto& chunk : faces)
+		ids.insert(ids.end(), chunk.begin(), chunk.end());
+	data.indices.reserve(ids.size());
+
+	std::sort(ids.begin(), ids.end());
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+	if (!ids.empty() && (ids.front() < 1 || ids.back() > (int)v.size()))
+		return false;
+
+	std::vector<int> local_index(ids.size(), -1); // position in ids -> index into the mesh
+	for (auto& chunk : faces)
+		for (int id : chunk)
+		{
+			int& index = local_index[std::lower_bound(ids.begin(), ids.end(), id) - ids.begin()];
+			if (index < 0)
+			{
+				index = data.positions.size();
+				data.positions.push_back(v[id - 1].first);
+				data.colors.push_back(v[id - 1].second);
+			}
+			data.indices.push_back(index);
+		}
+	return true;
+}
+
+// Builds the meshes in parallel; the result keeps the order of sources
+static void build_meshes(const std::vector<MeshSource>& sources, const std::vector< std::pair<vec4,vec4> >& v, std::vector<Mesh>& meshes)
+{
+	size_t first = meshes.size();
+	meshes.resize(first + sources.size());
+	bool failed = false;
+
+	#pragma omp parallel for schedule(dynamic) if (sources.size() > 1)
+	for (int i = 0; i < (int)sources.size(); i++)
+	{
+		const MeshSource& source = sources[i];
+		Mesh& mesh = meshes[first + i];
+		mesh.type = source.type;
+
+		MeshData data;
+		bool valid = true;
+		if (!source.file.empty())
+		{
+			valid = load_mesh_file(source.file, source.color, data);
+		}
+		else
+		{
+			valid = build_indexed_mesh(source.faces, v, data);
+		}
+
+		//vertices are gathered in model space and moved to world space in one batch
+		transform_points(source.transformation, data.positions.data(), data.positions.data(), data.positions.size());
+		mesh.positions = Array<vec4>(std::move(data.positions));
+		mesh.colors = Array<vec4>(std::move(data.colors));
+		mesh.indices = Array<uint32_t>(std::move(data.indices));
+		compute_bounds(mesh);
+		compute_face_planes(mesh);
+		compute_meshlets(mesh);
+
+		if (!valid)
+		{
+			#pragma omp atomic write
+			failed = true;
+		}
+	}
+
+	if (failed)
+		throw ParseError();
+}
+
+// orthonormal camera basis from the gaze and up vectors
+static void setup_camera_basis(Camera& cam)
+{
+	cam.gaze = normalize4(cam.gaze);
+	cam.u = cross4(cam.gaze, cam.v);
+	cam.u = normalize4(cam.u);
+
+	cam.w = -cam.gaze;
+	cam.v = cross4(cam.u, cam.gaze);
+	cam.v = normalize4(cam.v);
+}
+
+// "left right bottom top near far width height"
+static void parse_image_plane(std::string_view text, Camera& cam)
+{
+	const char* first = text.data();
+	const char* last = first + text.size();
+
+	double* planes[] = { &cam.left, &cam.right, &cam.bottom, &cam.top, &cam.near, &cam.far };
+	for (double* plane : planes)
+		if (!parse_number(first, last, *plane))
+			return;
+
+	if (parse_number(first, last, cam.width))
+		parse_number(first, last, cam.height);
+}
+
+// "angle x y z"
+static void parse_rotation(std::string_view text, double& angle, vec4& u)
+{
+	const char* first = text.data();
+	const char* last = first + text.size();
+
+	if (parse_number(first, last, angle))
+		parse_numbers(first, last, &u[0], 3);
+}
+
+// "<r|s|t> id"
+static bool parse_transformation(std::string_view text, char& type, int& id)
+{
+	const char* first = text.data();
+	const char* last = first + text.size();
+
+	first = skip_whitespace(first, last);
+	if (first == last)
+		return false;
+	type = *first++;
+	return parse_number(first, last, id);
+}
+
+static mat4 apply_transformation(mat4c& composite_transformation, char type, int id,
+	std::map<int, mat4>& translations, std::map<int, mat4>& rotations, std::map<int, mat4>& scalings)
+{
+	switch(type) {
+		case 'r':
+			return rotations[id] * composite_transformation;
+		case 't':
+			return translations[id] * composite_transformation;
+		case 's':
+			return scalings[id] * composite_transformation;
+		default:
+			throw ParseError();
+	}
+}
+
 Scene::Scene(const char *xmlPath)
+{
+	if (is_rscene(xmlPath))
+	{
+		if (!read_rscene(xmlPath, *this))
+			throw ParseError();
+	}
+	else if (!load_stream(xmlPath))
+	{
+		cameras.clear();
+		meshes.clear();
+		load_document(xmlPath);
+	}
+
+	bvh.build(meshes);
+}
+
+void Scene::update_mesh(uint32_t mesh)
+{
+	compute_bounds(meshes[mesh]);
+	compute_face_planes(meshes[mesh]);
+	compute_meshlets(meshes[mesh]);
+	bvh.refit(meshes, mesh);
+}
+
+void Scene::load_document(const char *xmlPath)
 {
 	std::vector< std::pair<vec4,vec4> > v;
 	std::map<int, mat4> translations;
@@ -30,12 +371,13 @@ Scene::Scene(const char *xmlPath)
 		throw ParseError();
 	}
 
-	XMLNode *pRoot = xmlDoc.FirstChild();
+	XMLElement *pRoot = xmlDoc.FirstChildElement();
 
 	// read background color
 	pElement = pRoot->FirstChildElement("BackgroundColor");
 	str = pElement->GetText();
-	sscanf(str, "%lf %lf %lf", &background_color[0], &background_color[1], &background_color[2]);
+	parse_numbers(str, &background_color[0], 3);
+	background_color[3] = 255;
 
 	// read culling
 	pElement = pRoot->FirstChildElement("Culling");
@@ -77,29 +419,21 @@ Scene::Scene(const char *xmlPath)
 
 		camElement = pCamera->FirstChildElement("Position");
 		str = camElement->GetText();
-		sscanf(str, "%lf %lf %lf", &cam.pos[0], &cam.pos[1], &cam.pos[2]);
+		parse_numbers(str, &cam.pos[0], 3);
 
 		camElement = pCamera->FirstChildElement("Gaze");
 		str = camElement->GetText();
-		sscanf(str, "%lf %lf %lf", &cam.gaze[0], &cam.gaze[1], &cam.gaze[2]);
+		parse_numbers(str, &cam.gaze[0], 3);
 
 		camElement = pCamera->FirstChildElement("Up");
 		str = camElement->GetText();
-		sscanf(str, "%lf %lf %lf", &cam.v[0], &cam.v[1], &cam.v[2]);
+		parse_numbers(str, &cam.v[0], 3);
 
-		cam.gaze = normalize4(cam.gaze);
-		cam.u = cross4(cam.gaze, cam.v);
-		cam.u = normalize4(cam.u);
-
-		cam.w = -cam.gaze;
-		cam.v = cross4(cam.u, cam.gaze);
-		cam.v = normalize4(cam.v);
+		setup_camera_basis(cam);
 
 		camElement = pCamera->FirstChildElement("ImagePlane");
 		str = camElement->GetText();
-		sscanf(str, "%lf %lf %lf %lf %lf %lf %d %d",
-			   &cam.left, &cam.right, &cam.bottom, &cam.top,
-			   &cam.near, &cam.far, &cam.width, &cam.height);
+		parse_image_plane(str, cam);
 
 		camElement = pCamera->FirstChildElement("OutputName");
 		str = camElement->GetText();
@@ -112,7 +446,7 @@ Scene::Scene(const char *xmlPath)
 
 	// read vertices
 	pElement = pRoot->FirstChildElement("Vertices");
-	XMLElement *pVertex = pElement->FirstChildElement("Vertex");
+	XMLElement *pVertex = pElement != NULL ? pElement->FirstChildElement("Vertex") : NULL;
 	int vertexId = 1;
 
 	while (pVertex != NULL)
@@ -123,10 +457,10 @@ Scene::Scene(const char *xmlPath)
 		color[3] = 255;
 
 		str = pVertex->Attribute("position");
-		sscanf(str, "%lf %lf %lf", &vertex[0], &vertex[1], &vertex[2]);
+		parse_numbers(str, &vertex[0], 3);
 
 		str = pVertex->Attribute("color");
-		sscanf(str, "%lf %lf %lf", &color[0], &color[1], &color[2]);
+		parse_numbers(str, &color[0], 3);
 
 		v.push_back({vertex, color});
 
@@ -137,7 +471,7 @@ Scene::Scene(const char *xmlPath)
 
 	// read translations
 	pElement = pRoot->FirstChildElement("Translations");
-	XMLElement *pTranslation = pElement->FirstChildElement("Translation");
+	XMLElement *pTranslation = pElement != NULL ? pElement->FirstChildElement("Translation") : NULL;
 	while (pTranslation != NULL)
 	{
 		int id;
@@ -146,7 +480,7 @@ Scene::Scene(const char *xmlPath)
 		pTranslation->QueryIntAttribute("id", &id);
 
 		str = pTranslation->Attribute("value");
-		sscanf(str, "%lf %lf %lf", &xyz[0], &xyz[1], &xyz[2]);
+		parse_numbers(str, &xyz[0], 3);
 
 		translations[id] = mat4::transition(xyz);
 
@@ -155,7 +489,7 @@ Scene::Scene(const char *xmlPath)
 
 	// read scalings
 	pElement = pRoot->FirstChildElement("Scalings");
-	XMLElement *pScaling = pElement->FirstChildElement("Scaling");
+	XMLElement *pScaling = pElement != NULL ? pElement->FirstChildElement("Scaling") : NULL;
 	while (pScaling != NULL)
 	{
 		int id;
@@ -163,7 +497,7 @@ Scene::Scene(const char *xmlPath)
 
 		pScaling->QueryIntAttribute("id", &id);
 		str = pScaling->Attribute("value");
-		sscanf(str, "%lf %lf %lf", &xyz[0], &xyz[1], &xyz[2]);
+		parse_numbers(str, &xyz[0], 3);
 
 		scalings[id] = mat4::scaling(xyz);
 
@@ -172,7 +506,7 @@ Scene::Scene(const char *xmlPath)
 
 	// read rotations
 	pElement = pRoot->FirstChildElement("Rotations");
-	XMLElement *pRotation = pElement->FirstChildElement("Rotation");
+	XMLElement *pRotation = pElement != NULL ? pElement->FirstChildElement("Rotation") : NULL;
 	while (pRotation != NULL)
 	{
 		int id;
@@ -181,7 +515,7 @@ Scene::Scene(const char *xmlPath)
 
 		pRotation->QueryIntAttribute("id", &id);
 		str = pRotation->Attribute("value");
-		sscanf(str, "%lf %lf %lf %lf", &angle, &u[0], &u[1], &u[2]);
+		parse_rotation(str, angle, u);
 
 		rotations[id] = mat4::rotation(u, angle);
 
@@ -193,10 +527,13 @@ Scene::Scene(const char *xmlPath)
 
 	XMLElement *pMesh = pElement->FirstChildElement("Mesh");
 	XMLElement *meshElement;
+
+	std::vector<MeshSource> sources;
+	std::vector<FacesChunk> chunks;
+
 	while (pMesh != NULL)
 	{
-		mat4 composite_transformation;
-		Mesh mesh;
+		MeshSource source;
 
 		{
 			int zort;
@@ -207,10 +544,10 @@ Scene::Scene(const char *xmlPath)
 		str = pMesh->Attribute("type");
 
 		if (strcmp(str, "wireframe") == 0) {
-			mesh.type = WIREFRAME;
+			source.type = WIREFRAME;
 		}
 		else {
-			mesh.type = SOLID;
+			source.type = SOLID;
 		}
 
 		// read mesh transformations
@@ -223,49 +560,330 @@ Scene::Scene(const char *xmlPath)
 			int id;
 
 			str = pTransformation->GetText();
-			sscanf(str, "%c %d", &type, &id);
-
-			switch(type) {
-				case 'r':
-					composite_transformation = rotations[id] * composite_transformation;
-				break;
-				case 't':
-					composite_transformation = translations[id] * composite_transformation;
-				break;
-				case 's':
-					composite_transformation = scalings[id] * composite_transformation;
-				break;
-				default:
-					throw ParseError();
-			}
+			if (str == NULL || !parse_transformation(str, type, id))
+				throw ParseError();
+
+			source.transformation = apply_transformation(source.transformation, type, id, translations, rotations, scalings);
 
 			pTransformation = pTransformation->NextSiblingElement("Transformation");
 		}
 
-		// read mesh faces
-		char *row;
-		char *clone_str;
-		int v1, v2, v3;
-		XMLElement *pFaces = pMesh->FirstChildElement("Faces");
-        str = pFaces->GetText();
-		clone_str = strdup(str);
+		// read mesh file, which replaces the faces
+		str = pMesh->Attribute("file");
+		if (str != NULL)
+		{
+			source.file = resolve_path(xmlPath, str);
+			str = pMesh->Attribute("color");
+			if (str != NULL)
+				parse_numbers(str, &source.color[0], 3);
+		}
 
-		row = strtok(clone_str, "\n");
-		while (row != NULL)
+		// split mesh faces, they are parsed below
+		XMLElement *pFaces = pMesh->FirstChildElement("Faces");
+		str = (pFaces != NULL && source.file.empty()) ? pFaces->GetText() : NULL;
+		if (str != NULL)
 		{
-			int result = sscanf(row, "%d %d %d", &v1, &v2, &v3);
-			
-			if (result != EOF) {
-				v1--, v2--, v3--;
-				auto tri = Triangle{
-					{composite_transformation * v[v1].first, composite_transformation * v[v2].first, composite_transformation * v[v3].first},
-					{v[v1].second, v[v2].second, v[v3].second} };
-				mesh.triangles.push_back(tri);
+			const char *last = str + strlen(str);
+			while (str != last)
+			{
+				const char *split = str + std::min<size_t>(last - str, FACES_CHUNK_SIZE);
+				if (split != last)
+				{
+					split = (const char *)memchr(split, '\n', last - split);
+					split = split != NULL ? split + 1 : last;
+				}
+
+				chunks.push_back({ sources.size(), source.faces.size(), str, split });
+				source.faces.emplace_back();
+				str = split;
 			}
-			row = strtok(NULL, "\n");
 		}
-		meshes.push_back(mesh);
+
+		sources.push_back(std::move(source));
 
 		pMesh = pMesh->NextSiblingElement("Mesh");
 	}
-}
\ No newline at end of file
+
+	if (!parse_faces(chunks, sources))
+		throw ParseError();
+
+	build_meshes(sources, v, meshes);
+}
+
+// skips the rest of the element whose START was just returned
+static void skip_element(XMLStream& xml)
+{
+	int depth = 1;
+	while (depth > 0)
+	{
+		switch (xml.next()) {
+			case XMLStream::START:
+				depth++;
+			break;
+			case XMLStream::END:
+				depth--;
+			break;
+			case XMLStream::DONE:
+				throw XMLStreamError();
+			default:
+			break;
+		}
+	}
+}
+
+// advances to the next child element, false once the parent is closed
+static bool next_child(XMLStream& xml)
+{
+	while (true)
+	{
+		switch (xml.next()) {
+			case XMLStream::START:
+				return true;
+			case XMLStream::END:
+				return false;
+			case XMLStream::DONE:
+				throw XMLStreamError();
+			default:
+			break;
+		}
+	}
+}
+
+// text of the element whose START was just returned, tokens joined by single spaces
+static void read_text(XMLStream& xml, std::string& text)
+{
+	text.clear();
+	while (true)
+	{
+		switch (xml.next()) {
+			case XMLStream::TEXT:
+				if (!text.empty())
+					text += ' ';
+				text += xml.text();
+			break;
+			case XMLStream::START:
+				skip_element(xml);
+			break;
+			case XMLStream::END:
+				return;
+			case XMLStream::DONE:
+				throw XMLStreamError();
+		}
+	}
+}
+
+static const char* require_attribute(XMLStream& xml, const char* key)
+{
+	const char* value = xml.attribute(key);
+	if (value == NULL)
+		throw XMLStreamError();
+	return value;
+}
+
+// Single pass over the file that writes vertices, transformations and faces
+// straight into their final arrays without building a DOM. Returns false when
+// the file needs the tinyxml2 loader instead, e.g. when it uses entities or
+// lists <Meshes> before the data they reference.
+bool Scene::load_stream(const char *xmlPath)
+{
+	XMLStream xml(xmlPath);
+	if (!xml.is_open())
+		return false;
+
+	std::vector< std::pair<vec4,vec4> > v;
+	std::map<int, mat4> translations;
+	std::map<int, mat4> rotations;
+	std::map<int, mat4> scalings;
+	std::vector<MeshSource> sources;
+	std::vector<FacesChunk> chunks;
+	std::vector<std::string> faces_text; // one string per chunk
+	std::string text;
+	bool meshes_read = false;
+
+	try
+	{
+		if (!next_child(xml))
+			return false;
+
+		while (next_child(xml))
+		{
+			const std::string& name = xml.name();
+
+			if (meshes_read && (name == "Vertices" || name == "Translations" || name == "Scalings" || name == "Rotations"))
+				return false;
+
+			if (name == "BackgroundColor")
+			{
+				read_text(xml, text);
+				parse_numbers(text.c_str(), &background_color[0], 3);
+				background_color[3] = 255;
+			}
+			else if (name == "Culling")
+			{
+				read_text(xml, text);
+				culling_enabled = text == "enabled";
+			}
+			else if (name == "Cameras")
+			{
+				while (next_child(xml))
+				{
+					if (xml.name() != "Camera")
+					{
+						skip_element(xml);
+						continue;
+					}
+
+					Camera cam;
+					cam.gaze[3] = 0;
+					cam.v[3] = 0;
+					cam.projection_type = strcmp(require_attribute(xml, "type"), "orthographic") == 0 ? ORTHOGRAPHIC : PERSPECTIVE;
+
+					while (next_child(xml))
+					{
+						std::string element = xml.name();
+						read_text(xml, text);
+						const char* str = text.c_str();
+
+						if (element == "Position")
+							parse_numbers(str, &cam.pos[0], 3);
+						else if (element == "Gaze")
+							parse_numbers(str, &cam.gaze[0], 3);
+						else if (element == "Up")
+							parse_numbers(str, &cam.v[0], 3);
+						else if (element == "ImagePlane")
+							parse_image_plane(text, cam);
+						else if (element == "OutputName")
+							cam.output_file_name = text;
+					}
+
+					setup_camera_basis(cam);
+					cameras.push_back(cam);
+				}
+			}
+			else if (name == "Vertices")
+			{
+				while (next_child(xml))
+				{
+					if (xml.name() == "Vertex")
+					{
+						vec4 vertex;
+						vec4 color;
+						vertex[3] = 1;
+						color[3] = 255;
+
+						parse_numbers(require_attribute(xml, "position"), &vertex[0], 3);
+						parse_numbers(require_attribute(xml, "color"), &color[0], 3);
+
+						v.push_back({vertex, color});
+					}
+					skip_element(xml);
+				}
+			}
+			else if (name == "Translations" || name == "Scalings" || name == "Rotations")
+			{
+				while (next_child(xml))
+				{
+					int id = 0;
+					parse_numbers(require_attribute(xml, "id"), &id, 1);
+					const char* str = require_attribute(xml, "value");
+					arr4 xyz;
+					double angle;
+					vec4 u;
+
+					if (xml.name() == "Translation")
+					{
+						parse_numbers(str, &xyz[0], 3);
+						translations[id] = mat4::transition(xyz);
+					}
+					else if (xml.name() == "Scaling")
+					{
+						parse_numbers(str, &xyz[0], 3);
+						scalings[id] = mat4::scaling(xyz);
+					}
+					else if (xml.name() == "Rotation")
+					{
+						parse_rotation(str, angle, u);
+						rotations[id] = mat4::rotation(u, angle);
+					}
+					skip_element(xml);
+				}
+			}
+			else if (name == "Meshes")
+			{
+				meshes_read = true;
+
+				while (next_child(xml))
+				{
+					if (xml.name() != "Mesh")
+					{
+						skip_element(xml);
+						continue;
+					}
+
+					MeshSource source;
+					source.type = strcmp(require_attribute(xml, "type"), "wireframe") == 0 ? WIREFRAME : SOLID;
+					if (xml.attribute("file") != NULL)
+					{
+						source.file = resolve_path(xmlPath, xml.attribute("file"));
+						if (xml.attribute("color") != NULL)
+							parse_numbers(xml.attribute("color"), &source.color[0], 3);
+					}
+
+					while (next_child(xml))
+					{
+						if (xml.name() == "Transformations")
+						{
+							while (next_child(xml))
+							{
+								char type;
+								int id;
+
+								read_text(xml, text);
+								if (!parse_transformation(text, type, id))
+									throw XMLStreamError();
+								source.transformation = apply_transformation(source.transformation, type, id, translations, rotations, scalings);
+							}
+						}
+						else if (xml.name() == "Faces" && source.file.empty())
+						{
+							//the text is kept in chunks that are parsed in parallel once the file is read
+							while (xml.read_raw_text(faces_text.emplace_back(), FACES_CHUNK_SIZE))
+							{
+								chunks.push_back({ sources.size(), source.faces.size(), NULL, NULL });
+								source.faces.emplace_back();
+							}
+							faces_text.pop_back();
+							if (xml.next() != XMLStream::END)
+								throw XMLStreamError();
+						}
+						else
+						{
+							skip_element(xml);
+						}
+					}
+
+					sources.push_back(std::move(source));
+				}
+			}
+			else
+			{
+				skip_element(xml);
+			}
+		}
+	}
+	catch (XMLStreamError&)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		chunks[i].first = faces_text[i].data();
+		chunks[i].last = faces_text[i].data() + faces_text[i].size();
+	}
+	if (!parse_faces(chunks, sources))
+		return false;
+
+	build_meshes(sources, v, meshes);
+	return true;
+}
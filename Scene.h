@@ -5,6 +5,8 @@
 #include <vector>
 
 #include "geometry.hpp"
+#include "mapped_file.hpp"
+#include "bvh.hpp"
 
 class Scene
 {
@@ -14,8 +16,19 @@ public:
 
 	std::vector< Camera > cameras;
 	std::vector< Mesh > meshes;
+	MappedFile compiled; // backing storage of the meshes when loaded from a compiled scene
+	BVH bvh;             // over meshes, kept current by update_mesh()
 
+	// loads an XML scene or a compiled .rscene file
 	Scene(const char *xmlPath);
+
+	// recomputes the bounds and culling data of meshes[mesh] after its
+	// vertices changed and refits the BVH above it
+	void update_mesh(uint32_t mesh);
+
+private:
+	bool load_stream(const char *xmlPath);
+	void load_document(const char *xmlPath);
 };
 
 #endif
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cfloat>
+
+#include "bvh.hpp"
+
+void BVH::build(const std::vector<Mesh>& scene_meshes)
+{
+	nodes.clear();
+	spheres.clear();
+	meshes.resize(scene_meshes.size());
+	mesh_leaf.resize(scene_meshes.size());
+	for (uint32_t i = 0; i < meshes.size(); i++)
+		meshes[i] = i;
+
+	if (meshes.empty())
+		return;
+
+	//a tree with n leaves has 2n - 1 nodes
+	nodes.reserve(2 * (meshes.size() / (BVH_LEAF_SIZE / 2) + 1));
+	nodes.push_back(BVHNode{ vec4{}, vec4{}, 0, 0, 0, (uint32_t)meshes.size(), 0 });
+	build_node(scene_meshes, 0);
+}
+
+void BVH::build_node(const std::vector<Mesh>& scene_meshes, uint32_t index)
+{
+	uint32_t first = nodes[index].first, count = nodes[index].count;
+	if (count <= BVH_LEAF_SIZE)
+	{
+		nodes[index].group = spheres.size() / (4 * BVH_LEAF_SIZE);
+		spheres.resize(spheres.size() + 4 * BVH_LEAF_SIZE, 0.0);
+		for (uint32_t i = first; i < first + count; i++)
+			mesh_leaf[meshes[i]] = index;
+		update_leaf(scene_meshes, nodes[index]);
+		return;
+	}
+
+	vec4 center_min = vec4{ DBL_MAX, DBL_MAX, DBL_MAX, 0 }, center_max = vec4{ -DBL_MAX, -DBL_MAX, -DBL_MAX, 0 };
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		center_min = min4(center_min, scene_meshes[meshes[i]].bounds_sphere);
+		center_max = max4(center_max, scene_meshes[meshes[i]].bounds_sphere);
+	}
+	vec4 extent = center_max - center_min;
+	int axis = extent[0] >= extent[1] && extent[0] >= extent[2] ? 0 : extent[1] >= extent[2] ? 1 : 2;
+
+	uint32_t half = count / 2;
+	std::nth_element(meshes.begin() + first, meshes.begin() + first + half, meshes.begin() + first + count, [&](uint32_t a, uint32_t b) {
+		return scene_meshes[a].bounds_sphere[axis] < scene_meshes[b].bounds_sphere[axis];
+	});
+
+	//nodes may reallocate below, so the children are filled in by index
+	uint32_t left = nodes.size();
+	nodes[index].left = left;
+	nodes.push_back(BVHNode{ vec4{}, vec4{}, index, 0, first, half, 0 });
+	nodes.push_back(BVHNode{ vec4{}, vec4{}, index, 0, first + half, count - half, 0 });
+	build_node(scene_meshes, left);
+	build_node(scene_meshes, left + 1);
+	update_inner(nodes[index]);
+}
+
+void BVH::update_leaf(const std::vector<Mesh>& scene_meshes, BVHNode& node)
+{
+	double* group = &spheres[node.group * 4 * BVH_LEAF_SIZE];
+	node.bounds_min = vec4{ DBL_MAX, DBL_MAX, DBL_MAX, 1 };
+	node.bounds_max = vec4{ -DBL_MAX, -DBL_MAX, -DBL_MAX, 1 };
+	for (uint32_t i = 0; i < node.count; i++)
+	{
+		const Mesh& mesh = scene_meshes[meshes[node.first + i]];
+		node.bounds_min = min4(node.bounds_min, mesh.bounds_min);
+		node.bounds_max = max4(node.bounds_max, mesh.bounds_max);
+		for (int k = 0; k < 4; k++)
+			group[k * BVH_LEAF_SIZE + i] = mesh.bounds_sphere[k];
+	}
+}
+
+void BVH::update_inner(BVHNode& node)
+{
+	const BVHNode& a = nodes[node.left], & b = nodes[node.left + 1];
+	node.bounds_min = min4(a.bounds_min, b.bounds_min);
+	node.bounds_max = max4(a.bounds_max, b.bounds_max);
+}
+
+//children always come after their parent, so a reverse sweep sees them first
+void BVH::refit(const std::vector<Mesh>& scene_meshes)
+{
+	for (size_t i = nodes.size(); i-- > 0;)
+	{
+		if (is_leaf(nodes[i]))
+			update_leaf(scene_meshes, nodes[i]);
+		else
+			update_inner(nodes[i]);
+	}
+}
+
+void BVH::refit(const std::vector<Mesh>& scene_meshes, uint32_t mesh)
+{
+	uint32_t index = mesh_leaf[mesh];
+	update_leaf(scene_meshes, nodes[index]);
+	while (index != 0)
+	{
+		index = nodes[index].parent;
+		update_inner(nodes[index]);
+	}
+}
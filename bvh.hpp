@@ -0,0 +1,52 @@
+#ifndef __BVH_H__
+#define __BVH_H__
+
+#include <vector>
+#include <cstdint>
+#include "geometry.hpp"
+
+#define BVH_LEAF_SIZE 8 // meshes per leaf, one SIMD group for the sphere tests
+
+// every node covers a contiguous range of BVH::meshes; inner nodes have
+// their two children next to each other at left and left + 1
+struct BVHNode
+{
+    vec4 bounds_min, bounds_max;
+    uint32_t parent;
+    uint32_t left;         // 0 for leaves, the root is never a child
+    uint32_t first, count; // range of BVH::meshes below the node
+    uint32_t group;        // leaves only, index of their sphere group
+};
+
+// Hierarchy over the AABBs of the scene meshes, built once per scene and
+// shared by every camera. Leaves keep the bounding spheres of their meshes
+// as x, y, z and radius arrays of BVH_LEAF_SIZE, so that they can be tested
+// in one SIMD step.
+class BVH
+{
+public:
+    std::vector<BVHNode> nodes;
+    std::vector<uint32_t> meshes;  // mesh indices in leaf order
+    std::vector<double> spheres;   // one group of 4 * BVH_LEAF_SIZE per leaf
+
+    // median split on the longest axis of the mesh centers
+    void build(const std::vector<Mesh>& scene_meshes);
+    // updates every node after meshes moved, keeping the topology; cheaper
+    // than a rebuild while the meshes stay roughly where they were
+    void refit(const std::vector<Mesh>& scene_meshes);
+    // updates only the leaf of mesh and its ancestors
+    void refit(const std::vector<Mesh>& scene_meshes, uint32_t mesh);
+
+    bool is_leaf(const BVHNode& node) const { return node.left == 0; }
+    // sphere arrays of a leaf
+    const double* leaf_spheres(const BVHNode& node) const { return &spheres[node.group * 4 * BVH_LEAF_SIZE]; }
+
+private:
+    std::vector<uint32_t> mesh_leaf; // leaf node of every mesh
+
+    void build_node(const std::vector<Mesh>& scene_meshes, uint32_t index);
+    void update_leaf(const std::vector<Mesh>& scene_meshes, BVHNode& node);
+    void update_inner(BVHNode& node);
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include <cmath>
+
+#include "camera_transform.hpp"
+#include "transform.hpp"
+
+static mat4 get_projection_matrix(const Camera& c)
+{
+	mat4 vp = mat4::identity();
+	double l = c.left, r = c.right, t = c.top, b = c.bottom;
+	double n = c.near, f = c.far;
+	vec4 u = c.u, v = c.v, w = c.w, e = c.pos;
+	u[3] = 0, v[3] = 0, w[3] = 0, e[3] = 0;
+
+	mat4c cam = mat4c(
+		row4{ u[0], u[1], u[2], -dot4(u, e)},
+		row4{ v[0], v[1], v[2], -dot4(v, e)},
+		row4{ w[0], w[1], w[2], -dot4(w, e)},
+		row4{ 0, 0, 0, 1 }
+	);
+
+	mat4c orth = mat4c(
+		row4{ 2.0 / (r - l), 0, 0, -((r + l) / (r - l)) },
+		row4{ 0, 2.0 / (t - b), 0, -((t + b) / (t - b)) },
+		row4{ 0, 0, -2.0 / (f - n), -((f + n) / (f - n)) },
+		row4{ 0, 0, 0, 1 }
+	);
+
+	if (c.projection_type == ORTHOGRAPHIC)
+	{
+		vp = orth * cam * vp;
+	}
+	else
+	{
+		mat4c per = mat4(
+			row4{ (2 * n) / (r - l), 0, (r + l) / (r - l), 0 },
+			row4{ 0, (2 * n) / (t - b), (t + b) / (t - b), 0 },
+			row4{ 0, 0, -(f + n) / (f - n), -(2 * f * n) / (f - n) },
+			row4{ 0, 0, -1, 0 }
+		);
+		vp = per * cam * vp;
+	}
+
+	return vp;
+}
+
+//includes the half pixel offset, (nx - 1) / 2 + 0.5
+static mat4 get_viewport_matrix(const Camera& c)
+{
+	double nx = c.width, ny = c.height;
+	return mat4(
+		row4{ nx / 2.0, 0, 0, nx / 2.0 },
+		row4{ 0, ny / 2.0, 0, ny / 2.0 },
+		row4{ 0, 0, 0.5, 0.5 },
+		row4{ 0, 0, 0, 1 }
+	);
+}
+
+CameraTransform::CameraTransform(const Camera& camera)
+{
+	projection = get_projection_matrix(camera);
+	screen = get_viewport_matrix(camera) * projection;
+	screenf = mat4f(screen);
+	perspective = camera.projection_type == PERSPECTIVE;
+
+	//-w <= x, y, z <= w in clip space, read off the rows of the projection
+	for (int i = 0; i < 6; i++)
+	{
+		vec4 plane = i % 2 == 0 ? projection.data[3] + projection.data[i / 2] : projection.data[3] - projection.data[i / 2];
+		frustum[i] = plane / std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+	}
+}
+
+//orthographic w stays 1, which is its own reciprocal
+template<typename T>
+static void project_screen(const basic_mat4<T>& screen, bool perspective, const vec4* in, basic_vec4<T>* out, size_t n)
+{
+	if (perspective)
+		project_points(screen, in, out, n);
+	else
+		transform_points(screen, in, out, n);
+}
+
+void CameraTransform::project(const vec4* in, vec4* out, size_t n) const
+{
+	project_screen(screen, perspective, in, out, n);
+}
+
+void CameraTransform::project(const vec4* in, vec4f* out, size_t n) const
+{
+	project_screen(screenf, perspective, in, out, n);
+}
+
+vec4 CameraTransform::project(vec4c point) const
+{
+	vec4 result = screen * point;
+	if (perspective)
+	{
+		double rcp = 1.0 / result[3];
+		result *= rcp;
+		result[3] = rcp;
+	}
+	return result;
+}
@@ -0,0 +1,34 @@
+#ifndef __CAMERA_TRANSFORM_H__
+#define __CAMERA_TRANSFORM_H__
+
+#include <cstddef>
+#include "mat4.hpp"
+#include "geometry.hpp"
+
+// World to screen mapping of one camera. Projection, viewport and the half
+// pixel offset of pixel centers are folded into a single matrix; the
+// viewport leaves w untouched, so dividing by w after the fused product is
+// the same as dividing between projection and viewport.
+class CameraTransform
+{
+public:
+    mat4 projection; // world to clip space
+    mat4 screen;     // world to screen space before the divide by w
+    mat4f screenf;   // screen narrowed to float, for the single precision path
+    bool perspective;
+    // world space planes of the view volume, normalized so that dot4(plane, p)
+    // with p[3] = 1 is the signed distance of p, positive inside. In the order
+    // left, right, bottom, top, near, far.
+    vec4 frustum[6];
+
+    CameraTransform(const Camera& camera);
+
+    // screen space positions of n world space points, with 1 / w in w so
+    // that points behind the eye can still be told apart; computed in the
+    // precision of out
+    void project(const vec4* in, vec4* out, size_t n) const;
+    void project(const vec4* in, vec4f* out, size_t n) const;
+    vec4 project(vec4c point) const;
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <utility>
+
+#include "clip.hpp"
+
+//signed distance to the plane, non-negative inside
+static double get_distance(vec4c p, int plane, int width, int height)
+{
+	switch (plane)
+	{
+		case CLIP_NEAR: return p[2];
+		case CLIP_FAR: return p[3] - p[2];
+		case CLIP_LEFT: return p[0] + CLIP_GUARD_BAND * p[3];
+		case CLIP_RIGHT: return (width + CLIP_GUARD_BAND) * p[3] - p[0];
+		case CLIP_BOTTOM: return p[1] + CLIP_GUARD_BAND * p[3];
+		default: return (height + CLIP_GUARD_BAND) * p[3] - p[1];
+	}
+}
+
+int clip_polygon(ClipVertex* polygon, int count, int planes, int width, int height)
+{
+	ClipVertex buffer[CLIP_MAX_VERTICES];
+	ClipVertex* in = polygon, * out = buffer;
+
+	for (int plane = CLIP_NEAR; plane <= CLIP_TOP && count > 0; plane <<= 1)
+	{
+		if (!(planes & plane))
+			continue;
+
+		int out_count = 0;
+		for (int i = 0; i < count; i++)
+		{
+			auto& a = in[i], & b = in[(i + 1) % count];
+			double da = get_distance(a.position, plane, width, height);
+			double db = get_distance(b.position, plane, width, height);
+
+			//rounding can leave a nearly degenerate polygon slightly non-convex, so that one
+			//plane adds more than one vertex; the buffers never take more than they hold
+			if (da >= 0 && out_count < CLIP_MAX_VERTICES)
+				out[out_count++] = a;
+			//the edge crosses the plane, an edge leaving it continues along the plane
+			if ((da >= 0) != (db >= 0) && out_count < CLIP_MAX_VERTICES)
+			{
+				double t = da / (da - db);
+				auto& v = out[out_count++];
+				v.position = a.position + (b.position - a.position) * t;
+				v.color = a.color + (b.color - a.color) * t;
+				v.edge = da < 0 && a.edge;
+			}
+		}
+		count = out_count;
+		std::swap(in, out);
+	}
+
+	if (in != polygon)
+		std::copy(in, in + count, polygon);
+	return count;
+}
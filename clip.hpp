@@ -0,0 +1,60 @@
+#ifndef __CLIP_H__
+#define __CLIP_H__
+
+#include "vec.hpp"
+
+#define CLIP_GUARD_BAND 4096 // pixels past each viewport edge that are rasterized without clipping
+#define CLIP_MAX_VERTICES 16 // 9 for a triangle clipped by all six planes, the rest is margin for rounding
+
+enum ClipPlane
+{
+    CLIP_NEAR = 1,
+    CLIP_FAR = 2,
+    CLIP_LEFT = 4,
+    CLIP_RIGHT = 8,
+    CLIP_BOTTOM = 16,
+    CLIP_TOP = 32,
+    CLIP_ALL = 63
+};
+
+// Planes are given in the homogeneous screen space of CameraTransform::screen,
+// which is clip space under a linear map, so clipping there and dividing
+// afterwards gives the same polygon. Only the guard band is clipped on x and
+// y; anything inside it is left to the tile bounds of the rasterizer.
+
+// outcode of a projected position that holds 1/w in its w component. Positions
+// behind the near plane only report CLIP_NEAR since their x and y are mirrored.
+template<typename V>
+inline int get_outcode(const V& p, int width, int height)
+{
+    if (!(p[3] > 0 && p[2] >= 0))
+        return CLIP_NEAR;
+
+    int code = 0;
+    if (p[2] > 1)
+        code |= CLIP_FAR;
+    if (p[0] < -CLIP_GUARD_BAND)
+        code |= CLIP_LEFT;
+    if (p[0] > width + CLIP_GUARD_BAND)
+        code |= CLIP_RIGHT;
+    if (p[1] < -CLIP_GUARD_BAND)
+        code |= CLIP_BOTTOM;
+    if (p[1] > height + CLIP_GUARD_BAND)
+        code |= CLIP_TOP;
+    return code;
+}
+
+struct ClipVertex
+{
+    vec4 position; // homogeneous, before the divide by w
+    vec4 color;
+    bool edge;     // the edge to the next vertex lies on the original triangle
+};
+
+// Sutherland-Hodgman against every plane in planes. polygon has room for
+// CLIP_MAX_VERTICES and is replaced by the clipped polygon, whose vertex
+// count is returned; 0 when nothing is left. Vertices past CLIP_MAX_VERTICES
+// are dropped.
+int clip_polygon(ClipVertex* polygon, int count, int planes, int width, int height);
+
+#endif
@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+
+#include "cull.hpp"
+
+// a group holds the x, y, z and radius of BVH_LEAF_SIZE spheres, one array each
+typedef void (*CullFunction)(const double* group, const vec4* planes, CullResult* result);
+
+static void cull_spheres_scalar(const double* group, const vec4* planes, CullResult* result)
+{
+	for (int i = 0; i < BVH_LEAF_SIZE; i++)
+	{
+		double x = group[i], y = group[BVH_LEAF_SIZE + i], z = group[2 * BVH_LEAF_SIZE + i], r = group[3 * BVH_LEAF_SIZE + i];
+		bool outside = false, inside = true;
+		for (int p = 0; p < 6; p++)
+		{
+			double d = planes[p][0] * x + planes[p][1] * y + planes[p][2] * z + planes[p][3];
+			outside = outside || d < -r;
+			inside = inside && d >= r;
+		}
+		result[i] = outside ? CULL_OUTSIDE : inside ? CULL_INSIDE : CULL_INTERSECTING;
+	}
+}
+
+static inline void store_masks(unsigned outside, unsigned inside, CullResult* result)
+{
+	for (int i = 0; i < BVH_LEAF_SIZE; i++)
+		result[i] = (outside >> i & 1) ? CULL_OUTSIDE : (inside >> i & 1) ? CULL_INSIDE : CULL_INTERSECTING;
+}
+
+//two halves of four spheres
+__attribute__((target("avx2,fma")))
+static void cull_spheres_avx2(const double* group, const vec4* planes, CullResult* result)
+{
+	unsigned outside = 0, inside = 0;
+	for (int h = 0; h < BVH_LEAF_SIZE; h += 4)
+	{
+		__m256d x = _mm256_loadu_pd(group + h);
+		__m256d y = _mm256_loadu_pd(group + BVH_LEAF_SIZE + h);
+		__m256d z = _mm256_loadu_pd(group + 2 * BVH_LEAF_SIZE + h);
+		__m256d r = _mm256_loadu_pd(group + 3 * BVH_LEAF_SIZE + h);
+		__m256d neg_r = _mm256_sub_pd(_mm256_setzero_pd(), r);
+
+		__m256d any_out = _mm256_setzero_pd(), all_in = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m256d d = _mm256_fmadd_pd(_mm256_set1_pd(planes[p][0]), x, _mm256_set1_pd(planes[p][3]));
+			d = _mm256_fmadd_pd(_mm256_set1_pd(planes[p][1]), y, d);
+			d = _mm256_fmadd_pd(_mm256_set1_pd(planes[p][2]), z, d);
+			any_out = _mm256_or_pd(any_out, _mm256_cmp_pd(d, neg_r, _CMP_LT_OQ));
+			all_in = _mm256_and_pd(all_in, _mm256_cmp_pd(d, r, _CMP_GE_OQ));
+		}
+		outside |= _mm256_movemask_pd(any_out) << h;
+		inside |= _mm256_movemask_pd(all_in) << h;
+	}
+	store_masks(outside, inside, result);
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static void cull_spheres_avx512(const double* group, const vec4* planes, CullResult* result)
+{
+	__m512d x = _mm512_loadu_pd(group);
+	__m512d y = _mm512_loadu_pd(group + BVH_LEAF_SIZE);
+	__m512d z = _mm512_loadu_pd(group + 2 * BVH_LEAF_SIZE);
+	__m512d r = _mm512_loadu_pd(group + 3 * BVH_LEAF_SIZE);
+	__m512d neg_r = _mm512_sub_pd(_mm512_setzero_pd(), r);
+
+	__mmask8 outside = 0, inside = 0xff;
+	for (int p = 0; p < 6; p++)
+	{
+		__m512d d = _mm512_fmadd_pd(_mm512_set1_pd(planes[p][0]), x, _mm512_set1_pd(planes[p][3]));
+		d = _mm512_fmadd_pd(_mm512_set1_pd(planes[p][1]), y, d);
+		d = _mm512_fmadd_pd(_mm512_set1_pd(planes[p][2]), z, d);
+		outside |= _mm512_cmp_pd_mask(d, neg_r, _CMP_LT_OQ);
+		inside &= _mm512_cmp_pd_mask(d, r, _CMP_GE_OQ);
+	}
+	store_masks(outside, inside, result);
+}
+
+static CullFunction get_cull_function()
+{
+	__builtin_cpu_init();
+	//the AVX-512 kernel is compiled for avx2 and fma as well
+	bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	if (avx2 && __builtin_cpu_supports("avx512f"))
+		return cull_spheres_avx512;
+	if (avx2)
+		return cull_spheres_avx2;
+	return cull_spheres_scalar;
+}
+
+static const CullFunction cull_spheres = get_cull_function();
+
+// Face planes are split into the four arrays of Mesh::face_planes, count
+// apart. Triangles in [first, last) are kept when eye lies in front of their
+// plane, or behind it for orthographic, and their indices written to out.
+typedef size_t (*BackfaceFunction)(const double* planes, size_t count, size_t first, size_t last, vec4c eye, bool orthographic, uint32_t* out);
+
+static inline size_t store_visible(unsigned mask, size_t i, size_t kept, uint32_t* out)
+{
+	for (; mask != 0; mask &= mask - 1)
+		out[kept++] = i + __builtin_ctz(mask);
+	return kept;
+}
+
+static size_t cull_backfaces_scalar(const double* planes, size_t count, size_t first, size_t last, vec4c eye, bool orthographic, uint32_t* out)
+{
+	size_t kept = 0;
+	for (size_t i = first; i < last; i++)
+	{
+		double d = planes[i] * eye[0] + planes[count + i] * eye[1] + planes[2 * count + i] * eye[2] - planes[3 * count + i];
+		//written so that NaN keeps the triangle for perspective, like the former test
+		bool cull = d <= 0;
+		if (orthographic)
+			cull = !cull;
+		if (!cull)
+			out[kept++] = i;
+	}
+	return kept;
+}
+
+__attribute__((target("avx2,fma")))
+static size_t cull_backfaces_avx2(const double* planes, size_t count, size_t first, size_t last, vec4c eye, bool orthographic, uint32_t* out)
+{
+	__m256d ex = _mm256_set1_pd(eye[0]), ey = _mm256_set1_pd(eye[1]), ez = _mm256_set1_pd(eye[2]);
+	size_t kept = 0, i = first;
+	for (; i + 8 <= last; i += 8)
+	{
+		unsigned mask = 0;
+		for (int h = 0; h < 8; h += 4)
+		{
+			__m256d d = _mm256_fmsub_pd(_mm256_loadu_pd(planes + i + h), ex, _mm256_loadu_pd(planes + 3 * count + i + h));
+			d = _mm256_fmadd_pd(_mm256_loadu_pd(planes + count + i + h), ey, d);
+			d = _mm256_fmadd_pd(_mm256_loadu_pd(planes + 2 * count + i + h), ez, d);
+			__m256d keep = orthographic ? _mm256_cmp_pd(d, _mm256_setzero_pd(), _CMP_LE_OQ) : _mm256_cmp_pd(d, _mm256_setzero_pd(), _CMP_NLE_UQ);
+			mask |= _mm256_movemask_pd(keep) << h;
+		}
+		kept = store_visible(mask, i, kept, out);
+	}
+	return kept + cull_backfaces_scalar(planes, count, i, last, eye, orthographic, out + kept);
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static size_t cull_backfaces_avx512(const double* planes, size_t count, size_t first, size_t last, vec4c eye, bool orthographic, uint32_t* out)
+{
+	__m512d ex = _mm512_set1_pd(eye[0]), ey = _mm512_set1_pd(eye[1]), ez = _mm512_set1_pd(eye[2]);
+	size_t kept = 0, i = first;
+	for (; i + 8 <= last; i += 8)
+	{
+		__m512d d = _mm512_fmsub_pd(_mm512_loadu_pd(planes + i), ex, _mm512_loadu_pd(planes + 3 * count + i));
+		d = _mm512_fmadd_pd(_mm512_loadu_pd(planes + count + i), ey, d);
+		d = _mm512_fmadd_pd(_mm512_loadu_pd(planes + 2 * count + i), ez, d);
+		__mmask8 keep = orthographic ? _mm512_cmp_pd_mask(d, _mm512_setzero_pd(), _CMP_LE_OQ) : _mm512_cmp_pd_mask(d, _mm512_setzero_pd(), _CMP_NLE_UQ);
+		kept = store_visible(keep, i, kept, out);
+	}
+	return kept + cull_backfaces_scalar(planes, count, i, last, eye, orthographic, out + kept);
+}
+
+static BackfaceFunction get_backface_function()
+{
+	__builtin_cpu_init();
+	//the AVX-512 kernel is compiled for avx2 and fma as well
+	bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+	if (avx2 && __builtin_cpu_supports("avx512f"))
+		return cull_backfaces_avx512;
+	if (avx2)
+		return cull_backfaces_avx2;
+	return cull_backfaces_scalar;
+}
+
+static const BackfaceFunction backface_kernel = get_backface_function();
+
+//p-vertex / n-vertex test, the corners furthest along and against each plane normal
+static CullResult cull_box(vec4c min, vec4c max, const vec4* planes)
+{
+	bool inside = true;
+	for (int p = 0; p < 6; p++)
+	{
+		vec4c& n = planes[p];
+		double far = n[3], near = n[3];
+		for (int k = 0; k < 3; k++)
+		{
+			far += n[k] * (n[k] >= 0 ? max[k] : min[k]);
+			near += n[k] * (n[k] >= 0 ? min[k] : max[k]);
+		}
+		if (far < 0)
+			return CULL_OUTSIDE;
+		inside = inside && near >= 0;
+	}
+	return inside ? CULL_INSIDE : CULL_INTERSECTING;
+}
+
+void cull_meshes(const BVH& bvh, const std::vector<Mesh>& meshes, const CameraTransform& camera_transform, std::vector<CullResult>& result)
+{
+	result.assign(meshes.size(), CULL_OUTSIDE);
+	if (bvh.nodes.empty())
+		return;
+
+	std::vector<uint32_t> stack(1, 0);
+	while (!stack.empty())
+	{
+		const BVHNode& node = bvh.nodes[stack.back()];
+		stack.pop_back();
+
+		CullResult node_result = cull_box(node.bounds_min, node.bounds_max, camera_transform.frustum);
+		if (node_result == CULL_OUTSIDE)
+			continue;
+		if (node_result == CULL_INSIDE)
+		{
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+				result[bvh.meshes[i]] = CULL_INSIDE;
+			continue;
+		}
+
+		if (!bvh.is_leaf(node))
+		{
+			stack.push_back(node.left);
+			stack.push_back(node.left + 1);
+			continue;
+		}
+
+		CullResult group_result[BVH_LEAF_SIZE];
+		cull_spheres(bvh.leaf_spheres(node), camera_transform.frustum, group_result);
+		for (uint32_t i = 0; i < node.count; i++)
+		{
+			uint32_t mesh = bvh.meshes[node.first + i];
+			result[mesh] = group_result[i] == CULL_INTERSECTING ? cull_box(meshes[mesh].bounds_min, meshes[mesh].bounds_max, camera_transform.frustum) : group_result[i];
+		}
+	}
+}
+
+//sphere of the meshlet entirely outside one of the planes
+static bool is_outside_frustum(vec4c sphere, const vec4* planes)
+{
+	for (int p = 0; p < 6; p++)
+		if (planes[p][0] * sphere[0] + planes[p][1] * sphere[1] + planes[p][2] * sphere[2] + planes[p][3] < -sphere[3])
+			return true;
+	return false;
+}
+
+// Every triangle of the meshlet faces away from eye when n . (p - eye) >= 0
+// for all unit normals n in the cone and points p in the sphere. With the
+// angle phi between the axis and the sphere center as seen from eye, the
+// smallest value is |v| cos(phi + theta) - r.
+static bool is_cone_culled(vec4c sphere, vec4c cone, vec4c eye)
+{
+	if (!(cone[3] > 0))
+		return false;
+
+	double vx = sphere[0] - eye[0], vy = sphere[1] - eye[1], vz = sphere[2] - eye[2];
+	double distance = std::sqrt(vx * vx + vy * vy + vz * vz);
+	double along = vx * cone[0] + vy * cone[1] + vz * cone[2];
+	double across = std::sqrt(std::max(0.0, distance * distance - along * along));
+	double sin_theta = std::sqrt(1 - cone[3] * cone[3]);
+	//the margin keeps triangles seen edge-on to the per-triangle test
+	return along * cone[3] - across * sin_theta >= sphere[3] + 1e-6 * distance;
+}
+
+static size_t cull_chunk(const Mesh& mesh, const CameraTransform& camera_transform, vec4c eye, bool test_frustum, bool backfaces, size_t first, size_t last, uint32_t* out)
+{
+	size_t count = mesh.triangle_count(), kept = 0;
+	bool test_cone = backfaces && camera_transform.perspective;
+	for (size_t m = first / MESHLET_SIZE; m * MESHLET_SIZE < last; m++)
+	{
+		if (test_frustum && is_outside_frustum(mesh.meshlet_spheres[m], camera_transform.frustum))
+			continue;
+		if (test_cone && is_cone_culled(mesh.meshlet_spheres[m], mesh.meshlet_cones[m], eye))
+			continue;
+
+		size_t meshlet_first = m * MESHLET_SIZE, meshlet_last = std::min(meshlet_first + MESHLET_SIZE, last);
+		if (backfaces)
+		{
+			kept += backface_kernel(mesh.face_planes.data(), count, meshlet_first, meshlet_last, eye, !camera_transform.perspective, out + kept);
+		}
+		else
+		{
+			for (size_t i = meshlet_first; i < meshlet_last; i++)
+				out[kept++] = i;
+		}
+	}
+	return kept;
+}
+
+void cull_triangles(const Mesh& mesh, const CameraTransform& camera_transform, vec4c eye, bool test_frustum, bool backfaces, std::vector<uint32_t>& visible)
+{
+	size_t count = mesh.triangle_count();
+	size_t chunks = (count + TRIANGLE_CHUNK_SIZE - 1) / TRIANGLE_CHUNK_SIZE;
+	visible.resize(count);
+	if (chunks <= 1)
+	{
+		visible.resize(cull_chunk(mesh, camera_transform, eye, test_frustum, backfaces, 0, count, visible.data()));
+		return;
+	}
+
+	//every chunk fills the start of its own range, which are then packed in order
+	std::vector<size_t> kept(chunks);
+	#pragma omp parallel for
+	for (long long c = 0; c < (long long)chunks; c++)
+	{
+		size_t first = c * TRIANGLE_CHUNK_SIZE, last = std::min(first + TRIANGLE_CHUNK_SIZE, count);
+		kept[c] = cull_chunk(mesh, camera_transform, eye, test_frustum, backfaces, first, last, visible.data() + first);
+	}
+
+	size_t total = kept[0];
+	for (size_t c = 1; c < chunks; c++)
+	{
+		std::copy_n(visible.begin() + c * TRIANGLE_CHUNK_SIZE, kept[c], visible.begin() + total);
+		total += kept[c];
+	}
+	visible.resize(total);
+}
@@ -0,0 +1,35 @@
+#ifndef __CULL_H__
+#define __CULL_H__
+
+#include <vector>
+#include <cstdint>
+#include "geometry.hpp"
+#include "camera_transform.hpp"
+#include "bvh.hpp"
+
+enum CullResult : uint8_t
+{
+    CULL_OUTSIDE,      // no part of the mesh is in view, skip it
+    CULL_INTERSECTING, // may cross the view volume, triangles need clipping
+    CULL_INSIDE        // entirely in view, triangles can skip clipping
+};
+
+// Classifies every mesh against the frustum of camera_transform. The BVH is
+// walked from the root and subtrees whose box is entirely outside or inside
+// are classified as a whole. In the leaves that remain, bounding spheres are
+// tested BVH_LEAF_SIZE meshes at a time; meshes whose sphere crosses a plane
+// are retried with their AABB, which is tighter for long thin meshes.
+void cull_meshes(const BVH& bvh, const std::vector<Mesh>& meshes, const CameraTransform& camera_transform, std::vector<CullResult>& result);
+
+#define TRIANGLE_CHUNK_SIZE 16384 // triangles per task when triangle culling is split across threads, a multiple of MESHLET_SIZE
+
+// Replaces visible with the indices of the triangles of mesh that may be
+// seen, in increasing order. Whole meshlets are dropped first, by their
+// sphere against the frustum unless the mesh is known to be inside it, and
+// with backfaces by their normal cone for perspective cameras. With
+// backfaces the triangles left are then tested against their precomputed
+// face planes 8 per step; orthographic cameras keep the opposite side, as
+// the per-triangle test always did.
+void cull_triangles(const Mesh& mesh, const CameraTransform& camera_transform, vec4c eye, bool test_frustum, bool backfaces, std::vector<uint32_t>& visible);
+
+#endif
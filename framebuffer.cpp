@@ -0,0 +1,200 @@
+#include "framebuffer.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+int clamp_pixel_value(double value)
+{
+	if (value >= 255.0)
+		return 255;
+	if (value <= 0.0)
+		return 0;
+	return (int)(value);
+}
+
+Framebuffer::Framebuffer(int width, int height, PixelFormat format)
+	: width(width), height(height), format(format)
+{
+	stride = (size_t)width * pixel_size(format);
+	stride = (stride + FRAMEBUFFER_ALIGNMENT - 1) / FRAMEBUFFER_ALIGNMENT * FRAMEBUFFER_ALIGNMENT;
+	data = (uint8_t*)std::aligned_alloc(FRAMEBUFFER_ALIGNMENT, std::max<size_t>(stride * height, FRAMEBUFFER_ALIGNMENT));
+}
+
+Framebuffer::~Framebuffer()
+{
+	std::free(data);
+}
+
+int Framebuffer::pixel_size(PixelFormat format)
+{
+	switch (format)
+	{
+		case RGBA8:
+			return 4;
+		case RGBA16F:
+			return 8;
+		default:
+			return 16;
+	}
+}
+
+void Framebuffer::clear(vec4c color)
+{
+	int size = pixel_size(format);
+	set_pixel(0, 0, color);
+	for (int x = 1; x < width; x++)
+		std::memcpy(row(0) + x * size, row(0), size);
+	for (int y = 1; y < height; y++)
+		std::memcpy(row(y), row(0), width * size);
+}
+
+__attribute__((target("f16c")))
+void Framebuffer::set_pixel(int x, int y, vec4c color)
+{
+	switch (format)
+	{
+		case RGBA8:
+		{
+			uint8_t* pixel = row(y) + x * 4;
+			for (int i = 0; i < 4; i++)
+				pixel[i] = clamp_pixel_value(color[i]);
+			break;
+		}
+		case RGBA16F:
+			_mm_storel_epi64((__m128i*)(row(y) + x * 8), _mm_cvtps_ph(_mm256_cvtpd_ps(color), _MM_FROUND_TO_NEAREST_INT));
+			break;
+		case RGBA32F:
+			_mm_storeu_ps((float*)(row(y) + x * 16), _mm256_cvtpd_ps(color));
+			break;
+	}
+}
+
+__attribute__((target("f16c")))
+void Framebuffer::set_pixel(int x, int y, vec4fc color)
+{
+	switch (format)
+	{
+		case RGBA8:
+		{
+			uint8_t* pixel = row(y) + x * 4;
+			for (int i = 0; i < 4; i++)
+				pixel[i] = clamp_pixel_value(color[i]);
+			break;
+		}
+		case RGBA16F:
+			_mm_storel_epi64((__m128i*)(row(y) + x * 8), _mm_cvtps_ph(color, _MM_FROUND_TO_NEAREST_INT));
+			break;
+		case RGBA32F:
+			_mm_storeu_ps((float*)(row(y) + x * 16), color);
+			break;
+	}
+}
+
+__attribute__((target("f16c")))
+vec4 Framebuffer::get_pixel(int x, int y) const
+{
+	switch (format)
+	{
+		case RGBA8:
+		{
+			const uint8_t* pixel = row(y) + x * 4;
+			return vec4{ (double)pixel[0], (double)pixel[1], (double)pixel[2], (double)pixel[3] };
+		}
+		case RGBA16F:
+			return _mm256_cvtps_pd(_mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)(row(y) + x * 8))));
+		default:
+			return _mm256_cvtps_pd(_mm_loadu_ps((const float*)(row(y) + x * 16)));
+	}
+}
+
+
+//converts two pixels per register, four per iteration, with the same clamp-and-truncate as clamp_pixel_value
+__attribute__((target("avx2,f16c")))
+static inline __m128i pack_rgba8x4(__m256 p01, __m256 p23)
+{
+	const __m256 lo = _mm256_setzero_ps(), hi = _mm256_set1_ps(255);
+	__m256i i01 = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(p01, lo), hi));
+	__m256i i23 = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(p23, lo), hi));
+	__m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(i01, i23), _MM_SHUFFLE(3, 1, 2, 0));
+	__m256i bytes = _mm256_packus_epi16(words, words);
+	return _mm256_castsi256_si128(_mm256_permute4x64_epi64(bytes, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+__attribute__((target("avx2,f16c")))
+const uint8_t* Framebuffer::rgba8_row(int y, uint8_t* scratch) const
+{
+	if (format == RGBA8)
+		return row(y);
+
+	int x = 0;
+	if (format == RGBA32F)
+	{
+		const float* src = (const float*)row(y);
+		for (; x + 4 <= width; x += 4)
+			_mm_storeu_si128((__m128i*)(scratch + x * 4), pack_rgba8x4(_mm256_loadu_ps(src + x * 4), _mm256_loadu_ps(src + x * 4 + 8)));
+	}
+	else
+	{
+		const uint16_t* src = (const uint16_t*)row(y);
+		for (; x + 4 <= width; x += 4)
+			_mm_storeu_si128((__m128i*)(scratch + x * 4), pack_rgba8x4(
+				_mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + x * 4))),
+				_mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + x * 4 + 8)))));
+	}
+
+	for (; x < width; x++)
+	{
+		vec4 value = get_pixel(x, y);
+		for (int i = 0; i < 4; i++)
+			scratch[x * 4 + i] = clamp_pixel_value(value[i]);
+	}
+	return scratch;
+}
+
+__attribute__((target("avx2,f16c")))
+void Framebuffer::rgb32f_row(int y, float* dst) const
+{
+	for (int x = 0; x < width; x++)
+	{
+		__m128 value;
+		if (format == RGBA8)
+			value = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_loadu_si32(row(y) + x * 4)));
+		else if (format == RGBA16F)
+			value = _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)(row(y) + x * 8)));
+		else
+			value = _mm_loadu_ps((const float*)(row(y) + x * 16));
+
+		value = _mm_mul_ps(value, _mm_set1_ps(1.0f / 255.0f));
+		alignas(16) float channels[4];
+		_mm_store_ps(channels, value);
+		dst[x * 3 + 0] = channels[0];
+		dst[x * 3 + 1] = channels[1];
+		dst[x * 3 + 2] = channels[2];
+	}
+}
+
+//drops the alpha byte of every pixel, eight pixels per shuffle
+__attribute__((target("avx2")))
+void rgba8_to_rgb8(const uint8_t* src, uint8_t* dst, int count)
+{
+	const __m256i drop_alpha = _mm256_setr_epi8(
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+
+	int i = 0;
+	//each store writes 32 bytes of which 24 are used, so stop while the spill still lands inside dst
+	for (; i + 11 <= count; i += 8)
+	{
+		__m256i pixels = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+		pixels = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(pixels, drop_alpha), compact);
+		_mm256_storeu_si256((__m256i*)(dst + i * 3), pixels);
+	}
+	for (; i < count; i++)
+	{
+		dst[i * 3 + 0] = src[i * 4 + 0];
+		dst[i * 3 + 1] = src[i * 4 + 1];
+		dst[i * 3 + 2] = src[i * 4 + 2];
+	}
+}
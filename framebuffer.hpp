@@ -0,0 +1,53 @@
+#ifndef __FRAMEBUFFER_H__
+#define __FRAMEBUFFER_H__
+
+#include <cstdint>
+#include <cstddef>
+#include "vec.hpp"
+
+#define FRAMEBUFFER_ALIGNMENT 64
+
+enum PixelFormat
+{
+    RGBA8, RGBA16F, RGBA32F
+};
+
+// A single row-major allocation. Rows are padded to FRAMEBUFFER_ALIGNMENT so
+// that every row starts on a cache line. RGBA8 stores colors clamped and
+// truncated to [0, 255] on write; RGBA16F and RGBA32F keep the unclamped
+// values for accumulation and leave clamping to the image writers.
+class Framebuffer
+{
+public:
+    int width, height;
+    PixelFormat format;
+    size_t stride;
+
+    Framebuffer(int width, int height, PixelFormat format = RGBA8);
+    ~Framebuffer();
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+
+    static int pixel_size(PixelFormat format);
+
+    uint8_t* row(int y) { return data + y * stride; }
+    const uint8_t* row(int y) const { return data + y * stride; }
+
+    void clear(vec4c color);
+    void set_pixel(int x, int y, vec4c color);
+    void set_pixel(int x, int y, vec4fc color);
+    vec4 get_pixel(int x, int y) const;
+
+    // row y as clamped RGBA8; RGBA8 rows are returned in place, other formats are converted into scratch
+    const uint8_t* rgba8_row(int y, uint8_t* scratch) const;
+    // row y as RGB floats scaled so that 255 maps to 1.0
+    void rgb32f_row(int y, float* dst) const;
+
+private:
+    uint8_t* data;
+};
+
+int clamp_pixel_value(double value);
+void rgba8_to_rgb8(const uint8_t* src, uint8_t* dst, int count);
+
+#endif
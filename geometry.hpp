@@ -4,6 +4,9 @@
 #include <vector>
 #include <array>
 #include <string>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
 #include "vec.hpp"
 
 enum RenderType
@@ -16,16 +19,98 @@ enum ProjectionType
     ORTHOGRAPHIC, PERSPECTIVE
 };
 
-struct Triangle
+// T is the precision of the vertex and color vectors
+template<typename T>
+struct BasicTriangle
 {
-    std::array<vec4, 3> v;
-    std::array<vec4, 3> color;
+    std::array<basic_vec4<T>, 3> v;
+    std::array<basic_vec4<T>, 3> color;
 };
 
+typedef BasicTriangle<double> Triangle;
+
+// not normalized, facing the side from which the vertices run clockwise
+inline vec4 get_triangle_normal(const Triangle& tri)
+{
+    auto edge1 = tri.v[2] - tri.v[0];
+    auto edge2 = tri.v[1] - tri.v[0];
+    return cross4(edge2, edge1);
+}
+
+inline vec4 get_triangle_center(const Triangle& tri)
+{
+    return (tri.v[0] + tri.v[1] + tri.v[2]) / 3.0;
+}
+
+struct Tile
+{
+    int x0, y0;
+    int x1, y1;
+};
+
+// Contiguous read-only array that either owns its elements or refers to
+// memory kept alive elsewhere, such as a memory-mapped compiled scene.
+template<typename T>
+class Array
+{
+public:
+    Array() {}
+    Array(const T* data, size_t size) : external(data), external_size(size) {}
+    Array(std::vector<T>&& values) : storage(std::move(values)) {}
+
+    const T* data() const { return external != NULL ? external : storage.data(); }
+    size_t size() const { return external != NULL ? external_size : storage.size(); }
+    bool empty() const { return size() == 0; }
+
+    const T& operator[](size_t i) const { return data()[i]; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+
+    // only for arrays that own their elements
+    void push_back(const T& value) { storage.push_back(value); }
+
+private:
+    std::vector<T> storage;
+    const T* external = NULL;
+    size_t external_size = 0;
+};
+
+#define MESHLET_SIZE 64 // triangles per meshlet
+
+// Indexed mesh: every vertex referenced by the faces is stored once, already in
+// world space, and each triangle is three 32-bit indices into it.
 struct Mesh
 {
     RenderType type;
-    std::vector<Triangle> triangles;
+    Array<vec4> positions;
+    Array<vec4> colors;
+    Array<uint32_t> indices;
+    vec4 bounds_min, bounds_max; // world-space AABB of all vertices
+    vec4 bounds_sphere;          // world-space bounding sphere, center in xyz and radius in w
+    // world-space plane of every triangle as four arrays of triangle_count():
+    // normal x, y, z and the dot product of the normal with the triangle center
+    Array<double> face_planes;
+    // bounding sphere and normal cone of every MESHLET_SIZE consecutive
+    // triangles; the cone has its unit axis in xyz and the cosine of its half
+    // angle in w, which is not positive when the normals spread too far
+    Array<vec4> meshlet_spheres;
+    Array<vec4> meshlet_cones;
+
+    size_t triangle_count() const { return indices.size() / 3; }
+
+    Triangle get_triangle(size_t i) const
+    {
+        uint32_t a = indices[3 * i], b = indices[3 * i + 1], c = indices[3 * i + 2];
+        return Triangle{ { positions[a], positions[b], positions[c] }, { colors[a], colors[b], colors[c] } };
+    }
+};
+
+// Vertex and index arrays read from a mesh file, in the file's own coordinates
+struct MeshData
+{
+    std::vector<vec4> positions;
+    std::vector<vec4> colors;
+    std::vector<uint32_t> indices; // three per triangle
 };
 
 struct Camera
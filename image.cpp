@@ -0,0 +1,53 @@
+#include "image.hpp"
+#include "ppm.hpp"
+#include "png.hpp"
+#include "qoi.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+bool write_file(const std::string& filename, const std::string& header, const uint8_t* body, size_t size)
+{
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (file == NULL)
+		return false;
+
+	bool ok = fwrite(header.data(), 1, header.size(), file) == header.size()
+		&& fwrite(body, 1, size, file) == size;
+	return fclose(file) == 0 && ok;
+}
+
+std::string get_extension(const std::string& filename)
+{
+	size_t dot = filename.find_last_of('.');
+	size_t slash = filename.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return "";
+
+	std::string extension = filename.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+	return extension;
+}
+
+PixelFormat get_output_pixel_format(const std::string& filename)
+{
+	if (get_extension(filename) == "pfm")
+		return RGBA32F;
+	return RGBA8;
+}
+
+void write_image(const Framebuffer& framebuffer, const std::string& filename, const ImageOptions& options)
+{
+	std::string extension = get_extension(filename);
+	if (extension == "png")
+		write_png(framebuffer, filename);
+	else if (extension == "qoi")
+		write_qoi(framebuffer, filename);
+	else if (extension == "pam")
+		write_pam(framebuffer, filename);
+	else if (extension == "pfm")
+		write_pfm(framebuffer, filename);
+	else
+		write_ppm(framebuffer, filename, options.ascii_ppm);
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef __IMAGE_H__
+#define __IMAGE_H__
+
+#include <string>
+#include "framebuffer.hpp"
+
+struct ImageOptions
+{
+    bool ascii_ppm = false; // write .ppm files as P3 instead of P6
+};
+
+// writes header followed by body with a single buffered write
+bool write_file(const std::string& filename, const std::string& header, const uint8_t* body, size_t size);
+// lower-cased extension of filename without the dot, empty when there is none
+std::string get_extension(const std::string& filename);
+// framebuffer storage the writer for filename works best with
+PixelFormat get_output_pixel_format(const std::string& filename);
+// picks the encoder from the extension of filename; anything unknown is written as PPM
+void write_image(const Framebuffer& framebuffer, const std::string& filename, const ImageOptions& options);
+
+#endif
\ No newline at end of file
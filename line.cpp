@@ -1,16 +1,18 @@
 #include "line.hpp"
 
-vec4 lerp_color(float cur, float min, float max, vec4 start, vec4 end)
+template<typename Color>
+Color lerp_color(float cur, float min, float max, Color start, Color end)
 {
 	float alpha = (cur - min) / (max - min);
 	return (1 - alpha) * start + alpha * end;
 }
 
-void draw_line(int x1, int y1, int x2, int y2, vec4 start_color, vec4 end_color, vec4** image_buffer, const int width, const int height)
+template<typename Color>
+void draw_line(int x1, int y1, int x2, int y2, Color start_color, Color end_color, Framebuffer& framebuffer, const Tile& tile)
 {
 	if (x1 > x2)
 	{
-		draw_line(x2, y2, x1, y1, end_color, start_color, image_buffer, width, height);
+		draw_line(x2, y2, x1, y1, end_color, start_color, framebuffer, tile);
 		return;
 	}
 
@@ -36,10 +38,10 @@ void draw_line(int x1, int y1, int x2, int y2, vec4 start_color, vec4 end_color,
 
 	if (line_slope > -1.0 && line_slope <= 1.0 && dx != 0)
 	{
-		for (x = x1; x < x2; x++)
+		for (x = x1; x < x2 && x < tile.x1; x++)
 		{
-			if (x >= 0)
-				image_buffer[x][y] = lerp_color(x, x1, x2, start_color, end_color);
+			if (x >= tile.x0 && y >= tile.y0 && y < tile.y1)
+				framebuffer.set_pixel(x, y, lerp_color(x, x1, x2, start_color, end_color));
 
 			if (d <= 0)
 			{
@@ -62,10 +64,10 @@ void draw_line(int x1, int y1, int x2, int y2, vec4 start_color, vec4 end_color,
 			std::swap(y1, y2);
 		}
 
-		for (y = y1; y < y2; y++)
+		for (y = y1; y < y2 && y < tile.y1; y++)
 		{
-			if (x >= 0)
-				image_buffer[x][y] = lerp_color(y, y1, y2, start_color, end_color);
+			if (y >= tile.y0 && x >= tile.x0 && x < tile.x1)
+				framebuffer.set_pixel(x, y, lerp_color(y, y1, y2, start_color, end_color));
 
 			if (new_d <= 0)
 			{
@@ -99,7 +101,8 @@ float mini(float arr[], int n)
 	return m;
 }
 
-void clip_line(float x1, float y1, float x2, float y2, vec4 start_color, vec4 end_color, vec4** image_buffer, int width, int height)
+template<typename Color>
+void clip_line(float x1, float y1, float x2, float y2, Color start_color, Color end_color, Framebuffer& framebuffer, int width, int height, const Tile& tile)
 {
 	float p1 = -(x2 - x1);
 	float p2 = -p1;
@@ -169,5 +172,8 @@ void clip_line(float x1, float y1, float x2, float y2, vec4 start_color, vec4 en
 	//TODO fix color interpolation here (parts of the line may not be drawn yet color starts at start_color)
 	auto fixed_start_color = lerp_color(xn1, x1, x2, start_color, end_color);
 	auto fixed_end_color = lerp_color(xn2, x1, x2, start_color, end_color);
-	draw_line(xn1, yn1, xn2, yn2, fixed_start_color, fixed_end_color, image_buffer, width, height);
-}
\ No newline at end of file
+	draw_line(xn1, yn1, xn2, yn2, fixed_start_color, fixed_end_color, framebuffer, tile);
+}
+
+template void clip_line(float, float, float, float, vec4, vec4, Framebuffer&, int, int, const Tile&);
+template void clip_line(float, float, float, float, vec4f, vec4f, Framebuffer&, int, int, const Tile&);
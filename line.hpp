@@ -2,8 +2,13 @@
 #define __LINE_H__
 
 #include "vec.hpp"
+#include "geometry.hpp"
+#include "framebuffer.hpp"
 
-void clip_line(float x1, float y1, float x2, float y2, vec4 start_color, vec4 end_color, vec4** image_buffer, int width, int height);
-void draw_line(int x1, int y1, int x2, int y2, vec4 start_color, vec4 end_color, vec4** image_buffer, const int width, const int height);
+// Color is vec4 or vec4f, matching the precision of the triangles being drawn
+template<typename Color>
+void clip_line(float x1, float y1, float x2, float y2, Color start_color, Color end_color, Framebuffer& framebuffer, int width, int height, const Tile& tile);
+template<typename Color>
+void draw_line(int x1, int y1, int x2, int y2, Color start_color, Color end_color, Framebuffer& framebuffer, const Tile& tile);
 
 #endif
\ No newline at end of file
@@ -3,221 +3,288 @@
 #include <utility>
 #include "Scene.h"
 #include "mat4.hpp"
-#include "ppm.hpp"
-#include "line.hpp"
+#include "image.hpp"
+#include "raster.hpp"
+#include "rscene.hpp"
+#include "transform.hpp"
+#include "camera_transform.hpp"
+#include "clip.hpp"
+#include "cull.hpp"
 #include <cfloat>
+#include <cstring>
+#include <algorithm>
 
-mat4 get_projection_matrix(Camera& c)
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+bool is_mesh_occluded(const Mesh& mesh, const CameraTransform& camera_transform, DepthBuffer& depth_buffer)
 {
-	mat4 vp = mat4::identity();
-	double l = c.left, r = c.right, t = c.top, b = c.bottom;
-	double n = c.near, f = c.far;
-	vec4 u = c.u, v = c.v, w = c.w, e = c.pos;
-	u[3] = 0, v[3] = 0, w[3] = 0, e[3] = 0;
-
-	mat4c cam = mat4c(
-		row4{ u[0], u[1], u[2], -dot4(u, e)},
-		row4{ v[0], v[1], v[2], -dot4(v, e)},
-		row4{ w[0], w[1], w[2], -dot4(w, e)},
-		row4{ 0, 0, 0, 1 }
-	);
-
-	mat4c orth = mat4c(
-		row4{ 2.0 / (r - l), 0, 0, -((r + l) / (r - l)) },
-		row4{ 0, 2.0 / (t - b), 0, -((t + b) / (t - b)) },
-		row4{ 0, 0, -2.0 / (f - n), -((f + n) / (f - n)) },
-		row4{ 0, 0, 0, 1 }
-	);
-
-	if (c.projection_type == ORTHOGRAPHIC)
-	{
-		vp = orth * cam * vp;
-	}
-	else
+	//wireframes neither write nor test depth
+	if (mesh.type == WIREFRAME || mesh.indices.empty())
+		return false;
+
+	vec4 minb = vec4{ DBL_MAX, DBL_MAX, DBL_MAX, 0 }, maxb = vec4{ -DBL_MAX, -DBL_MAX, -DBL_MAX, 0 };
+	for (int i = 0; i < 8; i++)
 	{
-		mat4c per = mat4(
-			row4{ (2 * n) / (r - l), 0, (r + l) / (r - l), 0 },
-			row4{ 0, (2 * n) / (t - b), (t + b) / (t - b), 0 },
-			row4{ 0, 0, -(f + n) / (f - n), -(2 * f * n) / (f - n) },
-			row4{ 0, 0, -1, 0 }
-		);
-		vp = per * cam * vp;
+		vec4 corner = vec4{
+			(i & 1 ? mesh.bounds_max : mesh.bounds_min)[0],
+			(i & 2 ? mesh.bounds_max : mesh.bounds_min)[1],
+			(i & 4 ? mesh.bounds_max : mesh.bounds_min)[2], 1 };
+		corner = camera_transform.screen * corner;
+
+		if (camera_transform.perspective)
+		{
+			//the box reaches behind the eye, so its projection is unbounded
+			if (corner[3] <= 0)
+				return false;
+			corner *= 1.0 / corner[3];
+		}
+
+		minb = min4(minb, corner);
+		maxb = max4(maxb, corner);
 	}
 
-	return vp;
+	return depth_buffer.is_occluded(minb[0], minb[1], maxb[0], maxb[1], minb[2]);
 }
 
-mat4 get_viewport_matrix(Camera& c)
+//clips triangle i of mesh against planes and appends what is left as a fan of screen triangles
+template<typename T>
+void clip_triangle(const Mesh& mesh, int i, int planes, const CameraTransform& camera_transform, const Camera& camera, std::vector<ScreenTriangle<T>>& screen_triangles)
 {
-	double nx = c.width, ny = c.height;
-	return mat4(
-		row4{ nx / 2.0, 0, 0, (nx - 1.0) / 2.0 },
-		row4{ 0, ny / 2.0, 0, (ny - 1.0) / 2.0 },
-		row4{ 0, 0, 0.5, 0.5 },
-		row4{ 0, 0, 0, 1 }
-	);
-}
+	ClipVertex polygon[CLIP_MAX_VERTICES];
+	for (int k = 0; k < 3; k++)
+	{
+		uint32_t index = mesh.indices[3 * i + k];
+		polygon[k] = ClipVertex{ camera_transform.screen * mesh.positions[index], mesh.colors[index], true };
+	}
 
-vec4 get_triangle_normal(const Triangle& tri)
-{
-	auto edge1 = tri.v[2] - tri.v[0];
-	auto edge2 = tri.v[1] - tri.v[0];
-	return cross4(edge2, edge1);
-}
+	int count = clip_polygon(polygon, 3, planes, camera.width, camera.height);
+	basic_vec4<T> projected[CLIP_MAX_VERTICES];
+	for (int k = 0; k < count; k++)
+	{
+		double rcp = 1.0 / polygon[k].position[3];
+		vec4 p = polygon[k].position * rcp;
+		p[3] = rcp;
+		projected[k] = convert_vec4<T>(p);
+	}
 
-vec4 get_triangle_center(const Triangle& tri)
-{
-	return (tri.v[0] + tri.v[1] + tri.v[2]) / 3.0;
+	for (int k = 1; k + 1 < count; k++)
+	{
+		ScreenTriangle<T> st;
+		st.type = mesh.type;
+		st.tri = BasicTriangle<T>{
+			{ projected[0], projected[k], projected[k + 1] },
+			{ convert_vec4<T>(polygon[0].color), convert_vec4<T>(polygon[k].color), convert_vec4<T>(polygon[k + 1].color) } };
+		st.edges = (k == 1 && polygon[0].edge) | polygon[k].edge << 1 | (k + 2 == count && polygon[k + 1].edge) << 2;
+		st.visible = mesh.type == SOLID ? setup_triangle(st.tri, st.setup) : true;
+		screen_triangles.push_back(st);
+	}
 }
 
-std::pair<vec4, vec4> get_triangle_bounds(const Triangle& tri)
+//T selects the precision of the screen space triangles and of the rasterizer
+template<typename T>
+void render_camera(const Scene& scene, const Camera& camera, Framebuffer& framebuffer)
 {
-	vec4 curmin = vec4{ DBL_MAX, DBL_MAX, DBL_MAX, DBL_MAX }, curmax = {DBL_MIN, DBL_MIN, DBL_MIN, DBL_MIN };
+	CameraTransform camera_transform(camera);
 
-	curmin = min4(curmin, tri.v[0]);
-	curmin = min4(curmin, tri.v[1]);
-	curmin = min4(curmin, tri.v[2]);
+	TileGrid grid(camera.width, camera.height);
+	DepthBuffer depth_buffer(camera.width, camera.height);
+	std::vector<ScreenTriangle<T>> screen_triangles;
+	std::vector<basic_vec4<T>> transformed;
+	std::vector<uint8_t> outcodes;
+	std::vector<uint8_t> clip_planes;
+	std::vector<uint32_t> visible_triangles;
 
-	curmax = max4(curmax, tri.v[0]);
-	curmax = max4(curmax, tri.v[1]);
-	curmax = max4(curmax, tri.v[2]);
+	auto flush = [&]() {
+		bin_triangles(grid, screen_triangles, depth_buffer);
+		rasterize_tiles(grid, screen_triangles, framebuffer, depth_buffer);
+		screen_triangles.clear();
+	};
 
-	return { curmin, curmax };
-}
+	std::vector<CullResult> visibility;
+	cull_meshes(scene.bvh, scene.meshes, camera_transform, visibility);
 
-double sample_line_equation(vec4c v0, vec4c v1, double x, double y)
-{
-	double x0 = v0[0], y0 = v0[1], x1 = v1[0], y1 = v1[1];
-	return x * (y0 - y1) + y * (x1 - x0) + (x0 * y1) - (y0 * x1);
-}
+	//meshes are rasterized in growing batches so that later meshes can be tested against the depth of earlier ones
+	size_t batch_size = RASTER_BATCH_MIN;
 
-void draw_solid(const Triangle& tri, vec4** image_buffer, int width, int height)
-{
-	auto v0 = tri.v[0], v1 = tri.v[1], v2 = tri.v[2];
-	auto v0_c = tri.color[0], v1_c = tri.color[1], v2_c = tri.color[2];
-	auto [minb, maxb] = get_triangle_bounds(tri);
-	for (int x = minb[0]; x < maxb[0]; x++)
+	for (size_t m = 0; m < scene.meshes.size(); m++)
 	{
-		for (int y = minb[1]; y < maxb[1]; y++)
-		{
-			double alpha = sample_line_equation(v1, v2, x, y) / sample_line_equation(v1, v2, v0[0], v0[1]);
-			double beta = sample_line_equation(v2, v0, x, y) / sample_line_equation(v2, v0, v1[0], v1[1]);
-			double gamma = sample_line_equation(v0, v1, x, y) / sample_line_equation(v0, v1, v2[0], v2[1]);
+		auto& mesh = scene.meshes[m];
+		if (visibility[m] == CULL_OUTSIDE || is_mesh_occluded(mesh, camera_transform, depth_buffer))
+			continue;
+		bool needs_clipping = visibility[m] != CULL_INSIDE;
 
-			if (alpha >= 0 && beta >= 0 && gamma >= 0 && x >= 0 && y >= 0 && x < width && y < height)
-			{
-				vec4 intp_color = alpha * v0_c + beta * v1_c + gamma * v2_c;
-				image_buffer[x][y] = intp_color;
-			}
-		}
-	}
-}
+		//every vertex is transformed once, however many triangles share it
+		transformed.resize(mesh.positions.size());
+		camera_transform.project(mesh.positions.data(), transformed.data(), mesh.positions.size());
 
-void render_camera(Scene& scene, Camera& camera, vec4** image_buffer)
-{
-	mat4 proj_matrix = get_projection_matrix(camera);
-	mat4 viewport_matrix = get_viewport_matrix(camera);
-
-	/*
-	clip_line(350, 350, 350, 699, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 525, 699, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 699, 699, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 699, 525, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 699, 350, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 699, 175, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 699, 0, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 525, 0, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 350, 0, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 175, 0, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 0, 0, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 0, 175, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 0, 350, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 0, 525, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 0, 699, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	clip_line(350, 350, 175, 699, vec4{ 0,0,0,1 }, vec4{ 0,0,0,1 }, image_buffer, camera.width, camera.height);
-	*/
-	
-	for (auto& mesh : scene.meshes)
-	{
-		for (auto tri : mesh.triangles)
+		cull_triangles(mesh, camera_transform, camera.pos, needs_clipping, scene.culling_enabled, visible_triangles);
+		size_t triangle_count = visible_triangles.size();
+
+		//meshes entirely in view have no outcodes to compute
+		if (needs_clipping)
 		{
-			if (scene.culling_enabled)
-			{
-				auto cull = dot4(get_triangle_normal(tri), camera.pos - get_triangle_center(tri)) <= 0.0;
-				if (camera.projection_type == ORTHOGRAPHIC)
-					cull = !cull;
-				if (cull)
-					continue;
-			}
+			outcodes.resize(transformed.size());
+			clip_planes.assign(triangle_count, 0);
+			#pragma omp parallel for if (transformed.size() > TRANSFORM_BATCH_SIZE)
+			for (long long i = 0; i < (long long)transformed.size(); i++)
+				outcodes[i] = get_outcode(transformed[i], camera.width, camera.height);
+		}
 
-			//projection
-			for (auto& coord : tri.v) 
-				coord = proj_matrix * coord;
+		size_t offset = screen_triangles.size();
+		screen_triangles.resize(offset + triangle_count);
 
-			//perspective divide
-			if (camera.projection_type == PERSPECTIVE)
-				for (auto& coord : tri.v)
-					coord /= coord[3];
+		#pragma omp parallel for
+		for (int i = 0; i < (int)triangle_count; i++)
+		{
+			auto& st = screen_triangles[offset + i];
+			st.type = mesh.type;
+			st.visible = true;
+			st.edges = 7;
 
-			//viewport transformation
-			for (auto& coord : tri.v)
+			const uint32_t* index = &mesh.indices[3 * visible_triangles[i]];
+			int outside = 0, crossing = 0;
+			if (needs_clipping)
 			{
-				coord = viewport_matrix * coord;
-				coord[0] += 0.5;
-				coord[1] += 0.5;
+				outside = outcodes[index[0]] & outcodes[index[1]] & outcodes[index[2]];
+				crossing = outcodes[index[0]] | outcodes[index[1]] | outcodes[index[2]];
 			}
-
-			if (mesh.type == WIREFRAME)
+			if (outside || crossing)
 			{
-				//draw wireframe
-				auto v0 = tri.v[0], v1 = tri.v[1], v2 = tri.v[2];
-				auto v0_c = tri.color[0], v1_c = tri.color[1], v2_c = tri.color[2];
-				clip_line(v0[0], v0[1], v1[0], v1[1], v0_c, v1_c, image_buffer, camera.width, camera.height);
-				clip_line(v1[0], v1[1], v2[0], v2[1], v1_c, v2_c, image_buffer, camera.width, camera.height);
-				clip_line(v2[0], v2[1], v0[0], v0[1], v2_c, v0_c, image_buffer, camera.width, camera.height);
+				//a vertex behind the near plane can leave the guard band anywhere once clipped
+				if (!outside)
+					clip_planes[i] = crossing & CLIP_NEAR ? CLIP_ALL : crossing;
+				st.visible = false;
+				continue;
 			}
-			else
+
+			st.tri = BasicTriangle<T>{
+				{ transformed[index[0]], transformed[index[1]], transformed[index[2]] },
+				{ convert_vec4<T>(mesh.colors[index[0]]), convert_vec4<T>(mesh.colors[index[1]]), convert_vec4<T>(mesh.colors[index[2]]) } };
+			//triangles behind the depth of every tile they touch skip setup
+			if (mesh.type == SOLID)
 			{
-				//draw solid
-				draw_solid(tri, image_buffer, camera.width, camera.height);
+				auto [minb, maxb] = get_triangle_bounds(st.tri);
+				st.visible = !depth_buffer.is_occluded(minb[0], minb[1], maxb[0], maxb[1], minb[2]) && setup_triangle(st.tri, st.setup);
 			}
 		}
+
+		//only triangles crossing the near or far plane or the guard band get here
+		for (int i = 0; needs_clipping && i < (int)triangle_count; i++)
+			if (clip_planes[i])
+				clip_triangle(mesh, visible_triangles[i], clip_planes[i], camera_transform, camera, screen_triangles);
+
+		if (screen_triangles.size() >= batch_size)
+		{
+			flush();
+			batch_size = std::min<size_t>(batch_size * 2, RASTER_BATCH_MAX);
+		}
 	}
+	flush();
 }
 
-void ppm_to_png(std::string ppm_file)
+// Cameras only read the scene, so up to parallel_cameras of them render at once
+// and the thread budget is split evenly between them for their own tile, row
+// and encoder loops. While one camera encodes its image the others keep
+// rasterizing.
+void render_cameras(const Scene& scene, const ImageOptions& image_options, int threads, int parallel_cameras, bool single_precision)
 {
-	std::string command = "convert " + ppm_file + " " + ppm_file + ".png";
-	system(command.c_str());
+	int camera_count = scene.cameras.size();
+	if (camera_count == 0)
+		return;
+
+#ifdef _OPENMP
+	if (threads <= 0)
+		threads = omp_get_max_threads();
+	omp_set_max_active_levels(2);
+#else
+	threads = 1;
+#endif
+	if (parallel_cameras <= 0)
+		parallel_cameras = threads;
+	parallel_cameras = std::clamp(parallel_cameras, 1, camera_count);
+	int threads_per_camera = std::max(1, threads / parallel_cameras);
+
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(parallel_cameras)
+	for (int i = 0; i < camera_count; i++)
+	{
+#ifdef _OPENMP
+		omp_set_num_threads(threads_per_camera);
+#endif
+		auto& camera = scene.cameras[i];
+		Framebuffer framebuffer(camera.width, camera.height, get_output_pixel_format(camera.output_file_name));
+		framebuffer.clear(scene.background_color);
+
+		if (single_precision)
+			render_camera<float>(scene, camera, framebuffer);
+		else
+			render_camera<double>(scene, camera, framebuffer);
+
+		write_image(framebuffer, camera.output_file_name, image_options);
+	}
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    ImageOptions image_options;
+    const char* input_file_name = NULL;
+    const char* compile_file_name = NULL;
+    bool usage_error = false, single_precision = false;
+    int threads = 0, parallel_cameras = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--ascii") == 0)
+            image_options.ascii_ppm = true;
+        else if (strcmp(argv[i], "--float") == 0)
+            single_precision = true;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--parallel-cameras") == 0 && i + 1 < argc)
+            parallel_cameras = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--compile") == 0 && i + 2 < argc && input_file_name == NULL)
+        {
+            input_file_name = argv[++i];
+            compile_file_name = argv[++i];
+        }
+        else if (input_file_name == NULL)
+            input_file_name = argv[i];
+        else
+            usage_error = true;
+    }
+
+    if (usage_error || input_file_name == NULL)
     {
         std::cout << "Please run the rasterizer as:" << std::endl
-             << "\t./rasterizer <input_file_name>" << std::endl;
+             << "\t./rasterizer [--ascii] [--float] [--threads <n>] [--parallel-cameras <n>] <input_file_name>" << std::endl
+             << "or compile a scene for faster loading as:" << std::endl
+             << "\t./rasterizer --compile <scene.xml> <scene.rscene>" << std::endl;
         return EXIT_FAILURE;
     }
     else
     {
-        Scene scene(argv[1]);
+        Scene scene(input_file_name);
 
-        for (auto& camera : scene.cameras)
+        if (compile_file_name != NULL)
         {
-			vec4** image_buffer = new vec4*[camera.width];
-			for (int i = 0; i < camera.width; i++)
-			{
-				image_buffer[i] = new vec4[camera.height];
-				for (int j = 0; j < camera.height; j++)
-					image_buffer[i][j] = scene.background_color;
-			}
+            if (!write_rscene(scene, compile_file_name))
+            {
+                std::cout << "Could not write " << compile_file_name << std::endl;
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
+        }
 
-			render_camera(scene, camera, image_buffer);
+        for (auto& camera : scene.cameras)
+            if (camera.width > RASTER_MAX_SIZE || camera.height > RASTER_MAX_SIZE)
+            {
+                std::cout << "Image " << camera.output_file_name << " is larger than "
+                     << RASTER_MAX_SIZE << "x" << RASTER_MAX_SIZE << " pixels" << std::endl;
+                return EXIT_FAILURE;
+            }
 
-			write_ppm(image_buffer, camera.width, camera.height, camera.output_file_name);
-			//ppm_to_png(camera.output_file_name);
-        }
+        render_cameras(scene, image_options, threads, parallel_cameras, single_precision);
 
         return EXIT_SUCCESS;
     }
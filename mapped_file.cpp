@@ -0,0 +1,85 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size;
+	HANDLE mapping = NULL;
+	if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL)
+		return false;
+
+	//the view keeps the mapping alive after its handle is closed
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (view == NULL)
+		return false;
+
+	data = (const unsigned char*)view;
+	size = file_size.QuadPart;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data != NULL)
+		UnmapViewOfFile(data);
+	data = NULL;
+	size = 0;
+}
+
+#else
+
+bool MappedFile::open(const char* path)
+{
+	close();
+
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	void* view = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+		view = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED)
+		return false;
+
+	data = (const unsigned char*)view;
+	size = st.st_size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data != NULL)
+		munmap((void*)data, size);
+	data = NULL;
+	size = 0;
+}
+
+#endif
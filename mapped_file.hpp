@@ -0,0 +1,23 @@
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file, unmapped on destruction
+class MappedFile
+{
+public:
+    MappedFile() : data(NULL), size(0) {}
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // maps path, replacing any earlier mapping; false when the file cannot be mapped
+    bool open(const char* path);
+    void close();
+
+    const unsigned char* data;
+    size_t size;
+};
+
+#endif
@@ -7,22 +7,26 @@
 #include <cmath>
 #include "vec.hpp"
 
-// typedef const mat4f cmat4f;
-
-typedef const struct mat4 mat4c;
 typedef __m256d row4;
 typedef const row4 row4c;
 typedef const double cdouble;
 
-struct mat4 {
+// 4x4 matrix of T, double or float. Transformations are composed in double;
+// the float matrix is only a narrowed copy for the single precision kernels.
+template<typename T> struct basic_mat4;
+typedef basic_mat4<double> mat4;
+typedef const mat4 mat4c;
+
+template<>
+struct basic_mat4<double> {
 public:
     row4 data[4];
 
-    mat4() {
+    basic_mat4() {
         *this = mat4::identity();
     }
 
-    mat4(row4c r1, row4c r2, row4c r3, row4c r4) {
+    basic_mat4(row4c r1, row4c r2, row4c r3, row4c r4) {
         data[0] = r1;
         data[1] = r2;
         data[2] = r3;
@@ -286,4 +290,28 @@ inline mat4 mat4::inv() const {
     return ret;
 }
 
+template<>
+struct basic_mat4<float> {
+public:
+    vec4f data[4];
+
+    basic_mat4() {}
+
+    explicit basic_mat4(mat4c& m) {
+        for (int i = 0; i < 4; i++)
+            data[i] = _mm256_cvtpd_ps(m.data[i]);
+    }
+
+    vec4f operator*(vec4fc rhs) const {
+        vec4f result;
+        for (int i = 0; i < 4; i++) {
+            vec4f p = data[i] * rhs;
+            result[i] = (p[0] + p[1]) + (p[2] + p[3]);
+        }
+        return result;
+    }
+};
+
+typedef basic_mat4<float> mat4f;
+
 #endif
\ No newline at end of file
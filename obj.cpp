@@ -0,0 +1,182 @@
+#include <cstring>
+#include <algorithm>
+
+#include "obj.hpp"
+#include "mapped_file.hpp"
+#include "tokenizer.hpp"
+
+// v and f records of a range of whole lines
+struct ObjChunk
+{
+	const char *first, *last;
+	std::vector<vec4> positions;
+	std::vector<vec4> colors;
+	std::vector<int64_t> indices;   // 0-based; relative ones still count from the start of this chunk
+	std::vector<size_t> relative;  // positions in indices of negative (relative) references
+	bool ok = true;
+};
+
+//moves p past the current token
+static const char* skip_token(const char* p, const char* last)
+{
+	while (p != last && !is_whitespace(*p))
+		p++;
+	return p;
+}
+
+static void parse_vertex(ObjChunk& chunk, const char* p, const char* eol, vec4c default_color)
+{
+	vec4 position = vec4{ 0, 0, 0, 1 };
+	vec4 color = default_color;
+	double rgb[3];
+
+	if (parse_numbers(p, eol, &position[0], 3) != 3)
+	{
+		chunk.ok = false;
+		return;
+	}
+	if (parse_numbers(p, eol, rgb, 3) == 3)
+		color = vec4{ rgb[0] * 255, rgb[1] * 255, rgb[2] * 255, 255 };
+
+	chunk.positions.push_back(position);
+	chunk.colors.push_back(color);
+}
+
+static void parse_face(ObjChunk& chunk, const char* p, const char* eol)
+{
+	struct Corner
+	{
+		int64_t index;
+		bool relative;
+	};
+	Corner first_corner = {}, previous_corner = {};
+	int corners = 0;
+
+	while ((p = skip_whitespace(p, eol)) != eol)
+	{
+		//only the position of "v/vt/vn" is used
+		int64_t id;
+		if (!parse_number(p, eol, id) || id == 0)
+		{
+			chunk.ok = false;
+			return;
+		}
+		p = skip_token(p, eol);
+
+		Corner corner = { id < 0 ? (int64_t)chunk.positions.size() + id : id - 1, id < 0 };
+
+		//triangle fan around the first corner
+		if (corners >= 2)
+		{
+			for (const Corner& c : { first_corner, previous_corner, corner })
+			{
+				if (c.relative)
+					chunk.relative.push_back(chunk.indices.size());
+				chunk.indices.push_back(c.index);
+			}
+		}
+		if (corners == 0)
+			first_corner = corner;
+		previous_corner = corner;
+		corners++;
+	}
+
+	if (corners < 3)
+		chunk.ok = false;
+}
+
+static void parse_chunk(ObjChunk& chunk, vec4c default_color)
+{
+	const char* p = chunk.first;
+	while (p != chunk.last && chunk.ok)
+	{
+		const char* eol = (const char*)memchr(p, '\n', chunk.last - p);
+		if (eol == NULL)
+			eol = chunk.last;
+
+		p = skip_whitespace(p, eol);
+		if (eol - p >= 2 && is_whitespace(p[1]))
+		{
+			if (p[0] == 'v')
+				parse_vertex(chunk, p + 1, eol, default_color);
+			else if (p[0] == 'f')
+				parse_face(chunk, p + 1, eol);
+		}
+
+		p = eol != chunk.last ? eol + 1 : eol;
+	}
+}
+
+bool load_obj(const std::string& filename, vec4c default_color, MeshData& mesh)
+{
+	MappedFile file;
+	if (!file.open(filename.c_str()))
+		return false;
+
+	//chunks end at line breaks, so every record lies in a single chunk
+	std::vector<ObjChunk> chunks;
+	const char* first = (const char*)file.data;
+	const char* last = first + file.size;
+	while (first != last)
+	{
+		const char* split = first + std::min<size_t>(last - first, OBJ_CHUNK_SIZE);
+		if (split != last)
+		{
+			split = (const char*)memchr(split, '\n', last - split);
+			split = split != NULL ? split + 1 : last;
+		}
+
+		chunks.emplace_back();
+		chunks.back().first = first;
+		chunks.back().last = split;
+		first = split;
+	}
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int)chunks.size(); i++)
+		parse_chunk(chunks[i], default_color);
+
+	//offsets of every chunk in the concatenated arrays
+	std::vector<size_t> vertex_offset(chunks.size() + 1, 0), index_offset(chunks.size() + 1, 0);
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		if (!chunks[i].ok)
+			return false;
+		vertex_offset[i + 1] = vertex_offset[i] + chunks[i].positions.size();
+		index_offset[i + 1] = index_offset[i] + chunks[i].indices.size();
+	}
+
+	size_t vertex_count = vertex_offset.back();
+	if (vertex_count > UINT32_MAX)
+		return false;
+
+	mesh.positions.resize(vertex_count);
+	mesh.colors.resize(vertex_count);
+	mesh.indices.resize(index_offset.back());
+	bool valid = true;
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int)chunks.size(); i++)
+	{
+		ObjChunk& chunk = chunks[i];
+		for (size_t k : chunk.relative)
+			chunk.indices[k] += vertex_offset[i];
+
+		std::copy(chunk.positions.begin(), chunk.positions.end(), mesh.positions.begin() + vertex_offset[i]);
+		std::copy(chunk.colors.begin(), chunk.colors.end(), mesh.colors.begin() + vertex_offset[i]);
+
+		uint32_t* indices = mesh.indices.data() + index_offset[i];
+		for (size_t k = 0; k < chunk.indices.size(); k++)
+		{
+			if (chunk.indices[k] < 0 || chunk.indices[k] >= (int64_t)vertex_count)
+			{
+				#pragma omp atomic write
+				valid = false;
+				break;
+			}
+			indices[k] = chunk.indices[k];
+		}
+	}
+
+	return valid;
+}
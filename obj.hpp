@@ -0,0 +1,14 @@
+#ifndef __OBJ_H__
+#define __OBJ_H__
+
+#include <string>
+#include "geometry.hpp"
+
+#define OBJ_CHUNK_SIZE (1 << 22) // bytes of the file parsed per task
+
+// Reads the v and f records of a Wavefront OBJ file; polygons are fanned into
+// triangles and vertices without the "v x y z r g b" color extension get
+// default_color. Everything else in the file is ignored.
+bool load_obj(const std::string& filename, vec4c default_color, MeshData& mesh);
+
+#endif
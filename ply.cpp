@@ -0,0 +1,365 @@
+#include <cstring>
+#include <algorithm>
+#include <sstream>
+
+#include "ply.hpp"
+#include "mapped_file.hpp"
+
+enum PlyType
+{
+	PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64, PLY_INVALID
+};
+
+struct PlyProperty
+{
+	std::string name;
+	PlyType type;
+	bool is_list;
+	PlyType count_type; // for lists, type holds the item type
+};
+
+struct PlyElement
+{
+	std::string name;
+	size_t count;
+	std::vector<PlyProperty> properties;
+};
+
+static PlyType get_ply_type(const std::string& name)
+{
+	if (name == "char" || name == "int8") return PLY_INT8;
+	if (name == "uchar" || name == "uint8") return PLY_UINT8;
+	if (name == "short" || name == "int16") return PLY_INT16;
+	if (name == "ushort" || name == "uint16") return PLY_UINT16;
+	if (name == "int" || name == "int32") return PLY_INT32;
+	if (name == "uint" || name == "uint32") return PLY_UINT32;
+	if (name == "float" || name == "float32") return PLY_FLOAT32;
+	if (name == "double" || name == "float64") return PLY_FLOAT64;
+	return PLY_INVALID;
+}
+
+static size_t get_ply_type_size(PlyType type)
+{
+	static const size_t sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+	return sizes[type];
+}
+
+static bool is_ply_float(PlyType type)
+{
+	return type == PLY_FLOAT32 || type == PLY_FLOAT64;
+}
+
+//values are little-endian, which is also the host byte order
+static double read_ply_value(const unsigned char* p, PlyType type)
+{
+	switch (type) {
+		case PLY_INT8: { int8_t v; memcpy(&v, p, 1); return v; }
+		case PLY_UINT8: return *p;
+		case PLY_INT16: { int16_t v; memcpy(&v, p, 2); return v; }
+		case PLY_UINT16: { uint16_t v; memcpy(&v, p, 2); return v; }
+		case PLY_INT32: { int32_t v; memcpy(&v, p, 4); return v; }
+		case PLY_UINT32: { uint32_t v; memcpy(&v, p, 4); return v; }
+		case PLY_FLOAT32: { float v; memcpy(&v, p, 4); return v; }
+		default: { double v; memcpy(&v, p, 8); return v; }
+	}
+}
+
+// size of the element record at p in bytes, 0 when it runs past last
+static size_t get_record_size(const PlyElement& element, const unsigned char* p, const unsigned char* last)
+{
+	size_t size = 0;
+	for (auto& property : element.properties)
+	{
+		if (!property.is_list)
+		{
+			size += get_ply_type_size(property.type);
+			continue;
+		}
+
+		size_t count_size = get_ply_type_size(property.count_type);
+		if ((size_t)(last - p) < size + count_size)
+			return 0;
+		double count = read_ply_value(p + size, property.count_type);
+		if (count < 0)
+			return 0;
+		size += count_size + (size_t)count * get_ply_type_size(property.type);
+	}
+	return (size_t)(last - p) < size ? 0 : size;
+}
+
+// fixed record size of elements without list properties, 0 otherwise
+static size_t get_fixed_record_size(const PlyElement& element)
+{
+	size_t size = 0;
+	for (auto& property : element.properties)
+	{
+		if (property.is_list)
+			return 0;
+		size += get_ply_type_size(property.type);
+	}
+	return size;
+}
+
+static bool parse_header(const MappedFile& file, std::vector<PlyElement>& elements, size_t& data_offset)
+{
+	//the header lines may end in CRLF, the data starts right after the line break
+	static const char end_header[] = "end_header";
+	const char* text = (const char*)file.data, * last = text + file.size;
+	const char* end = std::search(text, last, end_header, end_header + strlen(end_header));
+	if (end == last)
+		return false;
+	const char* data = end + strlen(end_header);
+	if (data == last)
+		return false;
+	if (*data == '\r' && data + 1 != last)
+		data++;
+	if (*data != '\n')
+		return false;
+	data_offset = data + 1 - text;
+
+	std::istringstream header(std::string(text, end));
+	std::string line, keyword;
+	bool magic = false, binary_le = false;
+
+	while (std::getline(header, line))
+	{
+		std::istringstream words(line);
+		if (!(words >> keyword))
+			continue;
+
+		if (keyword == "ply")
+			magic = true;
+		else if (keyword == "format")
+		{
+			std::string format;
+			words >> format;
+			binary_le = format == "binary_little_endian";
+		}
+		else if (keyword == "element")
+		{
+			PlyElement element;
+			if (!(words >> element.name >> element.count))
+				return false;
+			elements.push_back(element);
+		}
+		else if (keyword == "property")
+		{
+			PlyProperty property;
+			std::string type;
+			if (elements.empty() || !(words >> type))
+				return false;
+
+			property.is_list = type == "list";
+			if (property.is_list)
+			{
+				std::string count_type;
+				words >> count_type >> type;
+				property.count_type = get_ply_type(count_type);
+				if (property.count_type == PLY_INVALID || is_ply_float(property.count_type))
+					return false;
+			}
+			property.type = get_ply_type(type);
+			if (property.type == PLY_INVALID || !(words >> property.name))
+				return false;
+			elements.back().properties.push_back(property);
+		}
+	}
+
+	return magic && binary_le;
+}
+
+static bool read_vertices(const PlyElement& element, const unsigned char* p, const unsigned char* last, vec4c default_color, MeshData& mesh, size_t& size)
+{
+	size_t stride = get_fixed_record_size(element);
+	if (stride == 0 || (size_t)(last - p) / stride < element.count)
+		return false;
+	size = stride * element.count;
+
+	//byte offset and type of x, y, z, red, green, blue
+	int offsets[6] = { -1, -1, -1, -1, -1, -1 };
+	PlyType types[6];
+	static const char* names[6] = { "x", "y", "z", "red", "green", "blue" };
+	int offset = 0;
+	for (auto& property : element.properties)
+	{
+		for (int k = 0; k < 6; k++)
+		{
+			if (property.name == names[k])
+			{
+				offsets[k] = offset;
+				types[k] = property.type;
+			}
+		}
+		offset += get_ply_type_size(property.type);
+	}
+	if (offsets[0] < 0 || offsets[1] < 0 || offsets[2] < 0)
+		return false;
+	bool has_color = offsets[3] >= 0 && offsets[4] >= 0 && offsets[5] >= 0;
+
+	mesh.positions.resize(element.count);
+	mesh.colors.resize(element.count);
+
+	#pragma omp parallel for
+	for (long long i = 0; i < (long long)element.count; i++)
+	{
+		const unsigned char* record = p + i * stride;
+		mesh.positions[i] = vec4{ read_ply_value(record + offsets[0], types[0]), read_ply_value(record + offsets[1], types[1]), read_ply_value(record + offsets[2], types[2]), 1 };
+
+		vec4 color = default_color;
+		if (has_color)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				//float colors are in [0, 1]
+				double value = read_ply_value(record + offsets[3 + k], types[3 + k]);
+				color[k] = is_ply_float(types[3 + k]) ? value * 255 : value;
+			}
+		}
+		mesh.colors[i] = color;
+	}
+	return true;
+}
+
+static bool read_faces(const PlyElement& element, const unsigned char* p, const unsigned char* last, MeshData& mesh, size_t& size)
+{
+	//byte offset of the index list in front of which every property has a fixed size
+	int list = -1;
+	size_t list_offset = 0;
+	for (size_t k = 0; k < element.properties.size(); k++)
+	{
+		auto& property = element.properties[k];
+		if (property.name == "vertex_indices" || property.name == "vertex_index")
+		{
+			list = k;
+			break;
+		}
+		if (property.is_list)
+			return false;
+		list_offset += get_ply_type_size(property.type);
+	}
+	if (list < 0 || !element.properties[list].is_list)
+		return false;
+
+	const PlyProperty& indices = element.properties[list];
+	size_t count_size = get_ply_type_size(indices.count_type);
+	size_t item_size = get_ply_type_size(indices.type);
+	uint32_t vertex_count = mesh.positions.size();
+	bool valid = true;
+
+	//when every face is a triangle records have a fixed size and are read in parallel
+	PlyElement triangle_element = element;
+	triangle_element.properties[list].is_list = false;
+	size_t fixed_size = get_fixed_record_size(triangle_element);
+	size_t stride = fixed_size + count_size + 2 * item_size;
+	bool triangles = fixed_size != 0 && (size_t)(last - p) / stride >= element.count;
+
+	if (triangles)
+	{
+		#pragma omp parallel for reduction(&&:triangles)
+		for (long long i = 0; i < (long long)element.count; i++)
+			triangles = triangles && read_ply_value(p + i * stride + list_offset, indices.count_type) == 3;
+	}
+
+	if (triangles)
+	{
+		size = stride * element.count;
+		mesh.indices.resize(3 * element.count);
+
+		#pragma omp parallel for
+		for (long long i = 0; i < (long long)element.count; i++)
+		{
+			const unsigned char* items = p + i * stride + list_offset + count_size;
+			for (int k = 0; k < 3; k++)
+			{
+				double index = read_ply_value(items + k * item_size, indices.type);
+				if (index < 0 || index >= vertex_count)
+				{
+					#pragma omp atomic write
+					valid = false;
+					index = 0;
+				}
+				mesh.indices[3 * i + k] = index;
+			}
+		}
+		return valid;
+	}
+
+	//general polygons, fanned into triangles
+	const unsigned char* record = p;
+	for (size_t i = 0; i < element.count; i++)
+	{
+		size_t record_size = get_record_size(element, record, last);
+		if (record_size == 0)
+			return false;
+
+		const unsigned char* items = record + list_offset + count_size;
+		size_t corners = read_ply_value(record + list_offset, indices.count_type);
+		for (size_t k = 2; k < corners; k++)
+		{
+			for (size_t corner : { (size_t)0, k - 1, k })
+			{
+				double index = read_ply_value(items + corner * item_size, indices.type);
+				if (index < 0 || index >= vertex_count)
+					return false;
+				mesh.indices.push_back(index);
+			}
+		}
+		record += record_size;
+	}
+	size = record - p;
+	return true;
+}
+
+bool load_ply(const std::string& filename, vec4c default_color, MeshData& mesh)
+{
+	MappedFile file;
+	std::vector<PlyElement> elements;
+	size_t data_offset;
+	if (!file.open(filename.c_str()) || !parse_header(file, elements, data_offset))
+		return false;
+
+	const unsigned char* p = file.data + data_offset;
+	const unsigned char* last = file.data + file.size;
+	bool has_vertices = false, has_faces = false;
+
+	for (auto& element : elements)
+	{
+		size_t size = 0;
+		if (element.name == "vertex")
+		{
+			if (!read_vertices(element, p, last, default_color, mesh, size))
+				return false;
+			has_vertices = true;
+		}
+		else if (element.name == "face")
+		{
+			//indices are checked against the vertices, which have to come first
+			if (!has_vertices || !read_faces(element, p, last, mesh, size))
+				return false;
+			has_faces = true;
+		}
+		else
+		{
+			size_t stride = get_fixed_record_size(element);
+			if (stride != 0)
+			{
+				if ((size_t)(last - p) / stride < element.count)
+					return false;
+				size = stride * element.count;
+			}
+			else
+			{
+				for (size_t i = 0; i < element.count; i++)
+				{
+					size_t record_size = get_record_size(element, p + size, last);
+					if (record_size == 0)
+						return false;
+					size += record_size;
+				}
+			}
+		}
+		p += size;
+	}
+
+	return has_vertices && has_faces;
+}
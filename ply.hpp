@@ -0,0 +1,12 @@
+#ifndef __PLY_H__
+#define __PLY_H__
+
+#include <string>
+#include "geometry.hpp"
+
+// Reads the vertex and face elements of a binary little-endian PLY file.
+// Vertex colors come from red, green and blue properties, default_color is
+// used when there are none; polygons are fanned into triangles.
+bool load_ply(const std::string& filename, vec4c default_color, MeshData& mesh);
+
+#endif
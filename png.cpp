@@ -0,0 +1,153 @@
+#include "png.hpp"
+#include "image.hpp"
+
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include <zlib.h>
+
+static void put_u32(std::string& out, uint32_t value)
+{
+	out += (char)(value >> 24);
+	out += (char)(value >> 16);
+	out += (char)(value >> 8);
+	out += (char)value;
+}
+
+static void put_chunk(std::string& out, const char* type, const uint8_t* data, size_t size)
+{
+	put_u32(out, size);
+	size_t start = out.size();
+	out.append(type, 4);
+	if (size > 0)
+		out.append((const char*)data, size);
+	put_u32(out, crc32(0, (const Bytef*)out.data() + start, size + 4));
+}
+
+static uint8_t paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+	if (pa <= pb && pa <= pc)
+		return a;
+	return pb <= pc ? b : c;
+}
+
+//tries every filter on the row and keeps the one with the smallest sum of absolute residuals
+//candidate is scratch of size bytes
+static void filter_row(const uint8_t* row, const uint8_t* prev, int size, uint8_t* candidate, uint8_t* out)
+{
+	long best_cost = -1;
+
+	for (int filter = 0; filter < 5; filter++)
+	{
+		long cost = 0;
+		for (int i = 0; i < size; i++)
+		{
+			int a = i >= 3 ? row[i - 3] : 0;
+			int b = prev ? prev[i] : 0;
+			int c = prev && i >= 3 ? prev[i - 3] : 0;
+			uint8_t predicted;
+			switch (filter)
+			{
+				case 0: predicted = 0; break;
+				case 1: predicted = a; break;
+				case 2: predicted = b; break;
+				case 3: predicted = (a + b) / 2; break;
+				default: predicted = paeth(a, b, c); break;
+			}
+			candidate[i] = row[i] - predicted;
+			cost += std::abs((int8_t)candidate[i]);
+		}
+
+		if (best_cost < 0 || cost < best_cost)
+		{
+			best_cost = cost;
+			out[0] = filter;
+			std::copy(candidate, candidate + size, out + 1);
+		}
+	}
+}
+
+// Rows are split into chunks of PNG_CHUNK_ROWS that are filtered and deflated
+// independently. Every chunk but the last ends with a full flush, which
+// byte-aligns it and drops back-references, so the raw streams concatenate
+// into one valid zlib stream; the adler32s are combined the same way.
+void write_png(const Framebuffer& framebuffer, std::string filename)
+{
+	int width = framebuffer.width, height = framebuffer.height;
+	int row_size = width * 3;
+	int chunk_count = (height + PNG_CHUNK_ROWS - 1) / PNG_CHUNK_ROWS;
+
+	std::vector<std::vector<uint8_t>> compressed(chunk_count);
+	std::vector<uLong> checksums(chunk_count);
+	std::vector<uLong> lengths(chunk_count);
+
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int chunk = 0; chunk < chunk_count; chunk++)
+	{
+		int first = chunk * PNG_CHUNK_ROWS, last = std::min(first + PNG_CHUNK_ROWS, height);
+		std::vector<uint8_t> scratch(width * 4), rows(2 * row_size), candidate(row_size);
+		std::vector<uint8_t> filtered((size_t)(last - first) * (row_size + 1));
+
+		//image rows run top to bottom, the framebuffer bottom to top
+		uint8_t* row = rows.data(), * prev = rows.data() + row_size;
+		if (first > 0)
+			rgba8_to_rgb8(framebuffer.rgba8_row(height - first, scratch.data()), prev, width);
+
+		for (int j = first; j < last; j++)
+		{
+			rgba8_to_rgb8(framebuffer.rgba8_row(height - 1 - j, scratch.data()), row, width);
+			filter_row(row, j > 0 ? prev : NULL, row_size, candidate.data(), filtered.data() + (size_t)(j - first) * (row_size + 1));
+			std::swap(row, prev);
+		}
+
+		z_stream stream = {};
+		deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+		compressed[chunk].resize(deflateBound(&stream, filtered.size()) + 16);
+		stream.next_in = filtered.data();
+		stream.avail_in = filtered.size();
+		stream.next_out = compressed[chunk].data();
+		stream.avail_out = compressed[chunk].size();
+		deflate(&stream, chunk == chunk_count - 1 ? Z_FINISH : Z_FULL_FLUSH);
+		compressed[chunk].resize(stream.total_out);
+		deflateEnd(&stream);
+
+		checksums[chunk] = adler32(adler32(0, NULL, 0), filtered.data(), filtered.size());
+		lengths[chunk] = filtered.size();
+	}
+
+	std::vector<uint8_t> idat = { 0x78, 0x9C };
+	uLong checksum = adler32(0, NULL, 0);
+	for (int chunk = 0; chunk < chunk_count; chunk++)
+	{
+		idat.insert(idat.end(), compressed[chunk].begin(), compressed[chunk].end());
+		checksum = adler32_combine(checksum, checksums[chunk], lengths[chunk]);
+	}
+	for (int shift = 24; shift >= 0; shift -= 8)
+		idat.push_back(checksum >> shift);
+
+	uint8_t ihdr[13];
+	for (int i = 0; i < 4; i++)
+	{
+		ihdr[i] = width >> (24 - 8 * i);
+		ihdr[4 + i] = height >> (24 - 8 * i);
+	}
+	ihdr[8] = 8;  // bit depth
+	ihdr[9] = 2;  // truecolor
+	ihdr[10] = 0; // deflate
+	ihdr[11] = 0; // adaptive filtering
+	ihdr[12] = 0; // no interlace
+
+	std::string header = "\x89PNG\r\n\x1a\n";
+	put_chunk(header, "IHDR", ihdr, sizeof(ihdr));
+	put_u32(header, idat.size());
+	header += "IDAT";
+
+	std::string trailer;
+	put_u32(trailer, crc32(crc32(0, (const Bytef*)"IDAT", 4), idat.data(), idat.size()));
+	put_chunk(trailer, "IEND", NULL, 0);
+	idat.insert(idat.end(), trailer.begin(), trailer.end());
+
+	write_file(filename, header, idat.data(), idat.size());
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#ifndef __PNG_H__
+#define __PNG_H__
+
+#include <string>
+#include "framebuffer.hpp"
+
+#define PNG_CHUNK_ROWS 64
+
+void write_png(const Framebuffer& framebuffer, std::string filename);
+
+#endif
\ No newline at end of file
@@ -1,37 +1,85 @@
 #include "ppm.hpp"
+#include "image.hpp"
 
 #include <fstream>
+#include <vector>
 
-int clamp_pixel_value(double value)
-{
-	if (value >= 255.0)
-		return 255;
-	if (value <= 0.0)
-		return 0;
-	return (int)(value);
-}
-
-void write_ppm(vec4** image_buffer, int width, int height, std::string filename)
+void write_ppm_ascii(const Framebuffer& framebuffer, std::string filename)
 {
 	std::ofstream file;
 
 	file.open(filename.c_str());
 
+	int width = framebuffer.width, height = framebuffer.height;
 	file << "P3" << std::endl;
 	file << "# " << filename << std::endl;
 	file << width << " " << height << std::endl;
 	file << "255" << std::endl;
 
+	std::vector<uint8_t> scratch(width * 4);
 	for (int j = height - 1; j >= 0; j--)
 	{
+		const uint8_t* row = framebuffer.rgba8_row(j, scratch.data());
 		for (int i = 0; i < width; i++)
 		{
-			vec4 value = image_buffer[i][j];
-			file << clamp_pixel_value(value[0]) << " "
-				<< clamp_pixel_value(value[1]) << " "
-				<< clamp_pixel_value(value[2]) << " ";
+			file << (int)row[i * 4 + 0] << " "
+				<< (int)row[i * 4 + 1] << " "
+				<< (int)row[i * 4 + 2] << " ";
 		}
-		file << std::endl;
+		file << '\n';
 	}
 	file.close();
+}
+
+void write_ppm(const Framebuffer& framebuffer, std::string filename, bool ascii)
+{
+	if (ascii)
+	{
+		write_ppm_ascii(framebuffer, filename);
+		return;
+	}
+
+	int width = framebuffer.width, height = framebuffer.height;
+	std::string header = "P6\n# " + filename + "\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+
+	std::vector<uint8_t> body((size_t)width * height * 3);
+	#pragma omp parallel
+	{
+		std::vector<uint8_t> scratch(width * 4);
+		#pragma omp for
+		for (int j = 0; j < height; j++)
+			rgba8_to_rgb8(framebuffer.rgba8_row(height - 1 - j, scratch.data()), body.data() + (size_t)j * width * 3, width);
+	}
+
+	write_file(filename, header, body.data(), body.size());
+}
+
+void write_pam(const Framebuffer& framebuffer, std::string filename)
+{
+	int width = framebuffer.width, height = framebuffer.height;
+	std::string header = "P7\nWIDTH " + std::to_string(width) + "\nHEIGHT " + std::to_string(height)
+		+ "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+
+	std::vector<uint8_t> body((size_t)width * height * 4);
+	std::vector<uint8_t> scratch(width * 4);
+	for (int j = 0; j < height; j++)
+	{
+		const uint8_t* row = framebuffer.rgba8_row(height - 1 - j, scratch.data());
+		std::copy(row, row + width * 4, body.data() + (size_t)j * width * 4);
+	}
+
+	write_file(filename, header, body.data(), body.size());
+}
+
+//PFM rows run bottom to top, which is already the framebuffer's order; the negative scale marks little-endian
+void write_pfm(const Framebuffer& framebuffer, std::string filename)
+{
+	int width = framebuffer.width, height = framebuffer.height;
+	std::string header = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+
+	std::vector<float> body((size_t)width * height * 3);
+	for (int j = 0; j < height; j++)
+		framebuffer.rgb32f_row(j, body.data() + (size_t)j * width * 3);
+
+	write_file(filename, header, (const uint8_t*)body.data(), body.size() * sizeof(float));
 }
\ No newline at end of file
@@ -1,8 +1,11 @@
 #ifndef __PPM_H__
 #define __PPM_H__
 
-#include "vec.hpp"
+#include <string>
+#include "framebuffer.hpp"
 
-void write_ppm(vec4** image_buffer, int width, int height, std::string filename);
+void write_ppm(const Framebuffer& framebuffer, std::string filename, bool ascii = false);
+void write_pam(const Framebuffer& framebuffer, std::string filename);
+void write_pfm(const Framebuffer& framebuffer, std::string filename);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "qoi.hpp"
+#include "image.hpp"
+
+#include <vector>
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xC0
+#define QOI_OP_RGB 0xFE
+
+// Encodes the RGB channels following the QOI specification (qoiformat.org);
+// alpha is written as opaque, which is what a 3-channel QOI file implies.
+void write_qoi(const Framebuffer& framebuffer, std::string filename)
+{
+	int width = framebuffer.width, height = framebuffer.height;
+
+	std::string header = "qoif";
+	for (uint32_t value : { (uint32_t)width, (uint32_t)height })
+		for (int shift = 24; shift >= 0; shift -= 8)
+			header += (char)(value >> shift);
+	header += (char)3; // channels
+	header += (char)0; // sRGB with linear alpha
+
+	std::vector<uint8_t> body;
+	body.reserve((size_t)width * height * 4 + 8);
+
+	//entries start as transparent black, which an opaque pixel never matches
+	uint8_t index[64][4] = {};
+	uint8_t prev[3] = { 0, 0, 0 };
+	int run = 0;
+
+	std::vector<uint8_t> scratch(width * 4), row(width * 3);
+	for (int j = height - 1; j >= 0; j--)
+	{
+		rgba8_to_rgb8(framebuffer.rgba8_row(j, scratch.data()), row.data(), width);
+		for (int i = 0; i < width; i++)
+		{
+			const uint8_t* px = &row[i * 3];
+			if (px[0] == prev[0] && px[1] == prev[1] && px[2] == prev[2])
+			{
+				if (++run == 62)
+				{
+					body.push_back(QOI_OP_RUN | (run - 1));
+					run = 0;
+				}
+				continue;
+			}
+
+			if (run > 0)
+			{
+				body.push_back(QOI_OP_RUN | (run - 1));
+				run = 0;
+			}
+
+			int hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + 255 * 11) % 64;
+			if (index[hash][0] == px[0] && index[hash][1] == px[1] && index[hash][2] == px[2] && index[hash][3] == 255)
+			{
+				body.push_back(QOI_OP_INDEX | hash);
+			}
+			else
+			{
+				index[hash][0] = px[0], index[hash][1] = px[1], index[hash][2] = px[2], index[hash][3] = 255;
+
+				int8_t dr = px[0] - prev[0], dg = px[1] - prev[1], db = px[2] - prev[2];
+				int8_t dr_dg = dr - dg, db_dg = db - dg;
+				if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+				{
+					body.push_back(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+				}
+				else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7)
+				{
+					body.push_back(QOI_OP_LUMA | (dg + 32));
+					body.push_back((dr_dg + 8) << 4 | (db_dg + 8));
+				}
+				else
+				{
+					body.push_back(QOI_OP_RGB);
+					body.push_back(px[0]);
+					body.push_back(px[1]);
+					body.push_back(px[2]);
+				}
+			}
+			prev[0] = px[0], prev[1] = px[1], prev[2] = px[2];
+		}
+	}
+
+	if (run > 0)
+		body.push_back(QOI_OP_RUN | (run - 1));
+	body.insert(body.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+
+	write_file(filename, header, body.data(), body.size());
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#ifndef __QOI_H__
+#define __QOI_H__
+
+#include <string>
+#include "framebuffer.hpp"
+
+void write_qoi(const Framebuffer& framebuffer, std::string filename);
+
+#endif
\ No newline at end of file
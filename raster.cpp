@@ -0,0 +1,340 @@
+#include "raster.hpp"
+#include "line.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+TileGrid::TileGrid(int width, int height)
+	: width(width), height(height)
+{
+	tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+	for (int ty = 0; ty < tiles_y; ty++)
+	{
+		for (int tx = 0; tx < tiles_x; tx++)
+		{
+			int x0 = tx * TILE_SIZE, y0 = ty * TILE_SIZE;
+			tiles.push_back(Tile{ x0, y0, std::min(x0 + TILE_SIZE, width), std::min(y0 + TILE_SIZE, height) });
+		}
+	}
+	bins.resize(tiles.size());
+}
+
+DepthBuffer::DepthBuffer(int width, int height)
+	: width(width), height(height), depth((size_t)width * height, std::numeric_limits<float>::infinity())
+{
+	blocks_x = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	blocks_y = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+	block_max.assign(blocks_x * blocks_y, std::numeric_limits<float>::infinity());
+	tile_max.assign(tiles_x * tiles_y, std::numeric_limits<float>::infinity());
+}
+
+void DepthBuffer::update_tile(const Tile& t)
+{
+	float farthest = 0;
+	for (int y = t.y0; y < t.y1; y += BLOCK_SIZE)
+		for (int x = t.x0; x < t.x1; x += BLOCK_SIZE)
+			farthest = std::max(farthest, block(x, y));
+	tile(t.x0, t.y0) = farthest;
+}
+
+//true when nothing at depth min_z or farther inside the screen rectangle can pass the depth test
+bool DepthBuffer::is_occluded(double min_x, double min_y, double max_x, double max_y, double min_z) const
+{
+	if (!(max_x >= 0 && max_y >= 0 && min_x < width && min_y < height))
+		return true;
+
+	int tx0 = (int)std::max(std::floor(min_x), 0.0) / TILE_SIZE;
+	int ty0 = (int)std::max(std::floor(min_y), 0.0) / TILE_SIZE;
+	int tx1 = (int)std::min(std::ceil(max_x), width - 1.0) / TILE_SIZE;
+	int ty1 = (int)std::min(std::ceil(max_y), height - 1.0) / TILE_SIZE;
+
+	for (int ty = ty0; ty <= ty1; ty++)
+		for (int tx = tx0; tx <= tx1; tx++)
+			if ((float)min_z < tile_max[ty * tiles_x + tx])
+				return false;
+	return true;
+}
+
+template<typename T>
+std::pair<basic_vec4<T>, basic_vec4<T>> get_triangle_bounds(const BasicTriangle<T>& tri)
+{
+	const T lo = std::numeric_limits<T>::lowest(), hi = std::numeric_limits<T>::max();
+	basic_vec4<T> curmin = { hi, hi, hi, hi }, curmax = { lo, lo, lo, lo };
+
+	curmin = min4(curmin, tri.v[0]);
+	curmin = min4(curmin, tri.v[1]);
+	curmin = min4(curmin, tri.v[2]);
+
+	curmax = max4(curmax, tri.v[0]);
+	curmax = max4(curmax, tri.v[1]);
+	curmax = max4(curmax, tri.v[2]);
+
+	return { curmin, curmax };
+}
+
+template<typename T>
+EdgeFunction<T> get_barycentric_function(const basic_vec4<T>& v0, const basic_vec4<T>& v1, const basic_vec4<T>& opposite)
+{
+	T x0 = v0[0], y0 = v0[1], x1 = v1[0], y1 = v1[1];
+	EdgeFunction<T> e{ y0 - y1, x1 - x0, (x0 * y1) - (y0 * x1) };
+	T inv_area = 1 / (e.a * opposite[0] + e.b * opposite[1] + e.c);
+	return EdgeFunction<T>{ e.a * inv_area, e.b * inv_area, e.c * inv_area };
+}
+
+//edge from (x0, y0) to (x1, y1) in subpixels, sign is that of the triangle area so that the inside is positive
+static FixedEdge get_fixed_edge(int64_t x0, int64_t y0, int64_t x1, int64_t y1, int64_t sign)
+{
+	int64_t a = (y0 - y1) * sign, b = (x1 - x0) * sign, c = (x0 * y1 - y0 * x1) * sign;
+	//y grows upwards in the framebuffer, so a top edge has the inside below it
+	bool top_left = a > 0 || (a == 0 && b < 0);
+	//pixel centers are whole pixels, one pixel step is SUBPIXEL_SCALE subpixels
+	return FixedEdge{ a * SUBPIXEL_SCALE, b * SUBPIXEL_SCALE, top_left ? c : c - 1 };
+}
+
+//pixels in [first, last] subpixels
+static int first_pixel(int64_t subpixels) { return (int)std::ceil((double)subpixels / SUBPIXEL_SCALE); }
+static int last_pixel(int64_t subpixels) { return (int)std::floor((double)subpixels / SUBPIXEL_SCALE); }
+
+template<typename T>
+bool setup_triangle(const BasicTriangle<T>& tri, TriangleSetup<T>& setup)
+{
+	//vertices are snapped to the subpixel grid, coverage is then exact integer arithmetic
+	int64_t x[3], y[3];
+	basic_vec4<T> v[3];
+	for (int i = 0; i < 3; i++)
+	{
+		if (!(std::abs(tri.v[i][0]) < SUBPIXEL_LIMIT && std::abs(tri.v[i][1]) < SUBPIXEL_LIMIT))
+			return false;
+		x[i] = std::llrint(tri.v[i][0] * SUBPIXEL_SCALE);
+		y[i] = std::llrint(tri.v[i][1] * SUBPIXEL_SCALE);
+		v[i] = tri.v[i];
+		v[i][0] = (T)x[i] / SUBPIXEL_SCALE;
+		v[i][1] = (T)y[i] / SUBPIXEL_SCALE;
+	}
+
+	int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (area == 0)
+		return false;
+
+	int64_t sign = area > 0 ? 1 : -1;
+	setup.edges[0] = get_fixed_edge(x[1], y[1], x[2], y[2], sign);
+	setup.edges[1] = get_fixed_edge(x[2], y[2], x[0], y[0], sign);
+	setup.edges[2] = get_fixed_edge(x[0], y[0], x[1], y[1], sign);
+	setup.min_x = first_pixel(std::min({ x[0], x[1], x[2] }));
+	setup.min_y = first_pixel(std::min({ y[0], y[1], y[2] }));
+	setup.max_x = last_pixel(std::max({ x[0], x[1], x[2] }));
+	setup.max_y = last_pixel(std::max({ y[0], y[1], y[2] }));
+
+	setup.alpha = get_barycentric_function<T>(v[1], v[2], v[0]);
+	setup.beta = get_barycentric_function<T>(v[2], v[0], v[1]);
+	setup.gamma = get_barycentric_function<T>(v[0], v[1], v[2]);
+
+	auto& ea = setup.alpha, & eb = setup.beta, & eg = setup.gamma;
+	setup.depth = EdgeFunction<T>{
+		ea.a * v[0][2] + eb.a * v[1][2] + eg.a * v[2][2],
+		ea.b * v[0][2] + eb.b * v[1][2] + eg.b * v[2][2],
+		ea.c * v[0][2] + eb.c * v[1][2] + eg.c * v[2][2] };
+	return true;
+}
+
+template<typename T>
+static const SolidSpanFunction<T> draw_span = get_solid_span_function<T>();
+
+enum BlockCoverage
+{
+	BLOCK_OUTSIDE, BLOCK_PARTIAL, BLOCK_INSIDE
+};
+
+//an edge function is linear, so its extremes over a block are at the block corners
+template<typename T>
+void get_block_range(const EdgeFunction<T>& e, int x, int y, int w, int h, T& lo, T& hi)
+{
+	T corner = e.a * x + e.b * y + e.c;
+	lo = corner + std::min<T>(e.a, 0) * (w - 1) + std::min<T>(e.b, 0) * (h - 1);
+	hi = corner + std::max<T>(e.a, 0) * (w - 1) + std::max<T>(e.b, 0) * (h - 1);
+}
+
+void get_block_range(const FixedEdge& e, int x, int y, int w, int h, int64_t& lo, int64_t& hi)
+{
+	int64_t corner = e.a * x + e.b * y + e.c;
+	lo = corner + std::min<int64_t>(e.a, 0) * (w - 1) + std::min<int64_t>(e.b, 0) * (h - 1);
+	hi = corner + std::max<int64_t>(e.a, 0) * (w - 1) + std::max<int64_t>(e.b, 0) * (h - 1);
+}
+
+template<typename T>
+BlockCoverage classify_block(const TriangleSetup<T>& setup, int x, int y, int w, int h)
+{
+	bool inside = true;
+	for (auto& e : setup.edges)
+	{
+		int64_t lo, hi;
+		get_block_range(e, x, y, w, h, lo, hi);
+		if (hi < 0)
+			return BLOCK_OUTSIDE;
+		if (lo < 0)
+			inside = false;
+	}
+	return inside ? BLOCK_INSIDE : BLOCK_PARTIAL;
+}
+
+template<typename T>
+void draw_block(const BasicTriangle<T>& tri, const TriangleSetup<T>& setup, Framebuffer& framebuffer, DepthBuffer& depth_buffer, int x, int y, int w, int h, bool test_edges)
+{
+	auto& ea = setup.alpha, & eb = setup.beta, & eg = setup.gamma;
+	//evaluated once at the block origin, then stepped down the rows
+	T alpha = ea.a * x + ea.b * y + ea.c, beta = eb.a * x + eb.b * y + eb.c, gamma = eg.a * x + eg.b * y + eg.c;
+	int64_t coverage[3];
+	for (int k = 0; k < 3; k++)
+		coverage[k] = setup.edges[k].a * x + setup.edges[k].b * y + setup.edges[k].c;
+
+	for (int j = y; j < y + h; j++)
+	{
+		draw_span<T>(framebuffer, depth_buffer.row(j), x, x + w, j, alpha, beta, gamma, test_edges ? coverage : NULL, setup, tri);
+		alpha += ea.b, beta += eb.b, gamma += eg.b;
+		for (int k = 0; k < 3; k++)
+			coverage[k] += setup.edges[k].b;
+	}
+}
+
+template<typename T>
+void draw_solid(const BasicTriangle<T>& tri, const TriangleSetup<T>& setup, Framebuffer& framebuffer, DepthBuffer& depth_buffer, const Tile& tile)
+{
+	auto [minb, maxb] = get_triangle_bounds(tri);
+	if ((float)minb[2] >= depth_buffer.tile(tile.x0, tile.y0))
+		return;
+
+	int min_x = std::max(setup.min_x, tile.x0), min_y = std::max(setup.min_y, tile.y0);
+	int max_x = std::min(setup.max_x + 1, tile.x1), max_y = std::min(setup.max_y + 1, tile.y1);
+	bool hiz_changed = false;
+
+	//blocks stay aligned to the BLOCK_SIZE grid so each maps to one block_max entry. Runs of
+	//neighbouring blocks in a row with the same coverage are drawn as one span, so that the
+	//span kernels get rows wider than a block.
+	for (int by = min_y - min_y % BLOCK_SIZE; by < max_y; by += BLOCK_SIZE)
+	{
+		int bh = std::min(BLOCK_SIZE, tile.y1 - by);
+		int y = std::max(by, min_y), h = std::min(by + BLOCK_SIZE, max_y) - y;
+		BlockCoverage run = BLOCK_OUTSIDE;
+		int run_x0 = 0, run_x1 = 0;
+
+		auto draw_run = [&]() {
+			if (run == BLOCK_INSIDE)
+				draw_block(tri, setup, framebuffer, depth_buffer, run_x0, by, run_x1 - run_x0, bh, false);
+			else if (run == BLOCK_PARTIAL)
+				draw_block(tri, setup, framebuffer, depth_buffer, run_x0, y, run_x1 - run_x0, h, true);
+			run = BLOCK_OUTSIDE;
+		};
+
+		for (int bx = min_x - min_x % BLOCK_SIZE; bx < max_x; bx += BLOCK_SIZE)
+		{
+			int bw = std::min(BLOCK_SIZE, tile.x1 - bx);
+			BlockCoverage coverage = BLOCK_OUTSIDE;
+
+			float& block_max = depth_buffer.block(bx, by);
+			T z_lo, z_hi;
+			get_block_range(setup.depth, bx, by, bw, bh, z_lo, z_hi);
+			if ((float)std::max(z_lo, minb[2]) < block_max)
+				coverage = classify_block<T>(setup, bx, by, bw, bh);
+
+			//inside blocks span the whole block, partial ones only the triangle bounds
+			int x0 = coverage == BLOCK_INSIDE ? bx : std::max(bx, min_x);
+			int x1 = coverage == BLOCK_INSIDE ? bx + bw : std::min(bx + BLOCK_SIZE, max_x);
+			if (coverage != run || x0 != run_x1)
+			{
+				draw_run();
+				run = coverage;
+				run_x0 = x0;
+			}
+			run_x1 = x1;
+
+			//every pixel of an inside block will hold at most the triangle's depth
+			if (coverage == BLOCK_INSIDE && (float)z_hi < block_max)
+			{
+				block_max = std::nextafter((float)z_hi, block_max);
+				hiz_changed = true;
+			}
+		}
+		draw_run();
+	}
+
+	if (hiz_changed)
+		depth_buffer.update_tile(tile);
+}
+
+template<typename T>
+void bin_triangles(TileGrid& grid, const std::vector<ScreenTriangle<T>>& triangles, const DepthBuffer& depth_buffer)
+{
+	for (auto& bin : grid.bins)
+		bin.clear();
+
+	for (int i = 0; i < (int)triangles.size(); i++)
+	{
+		auto& st = triangles[i];
+		if (!st.visible)
+			continue;
+
+		auto [minb, maxb] = get_triangle_bounds(st.tri);
+
+		//also rejects NaN bounds from degenerate projections
+		if (!(maxb[0] >= 0 && maxb[1] >= 0 && minb[0] < grid.width && minb[1] < grid.height))
+			continue;
+
+		int tx0 = (int)std::max<double>(std::floor(minb[0]), 0.0) / TILE_SIZE;
+		int ty0 = (int)std::max<double>(std::floor(minb[1]), 0.0) / TILE_SIZE;
+		int tx1 = (int)std::min<double>(std::ceil(maxb[0]), grid.width - 1.0) / TILE_SIZE;
+		int ty1 = (int)std::min<double>(std::ceil(maxb[1]), grid.height - 1.0) / TILE_SIZE;
+
+		//wireframes neither write nor test depth
+		bool test_depth = st.type == SOLID;
+		for (int ty = ty0; ty <= ty1; ty++)
+			for (int tx = tx0; tx <= tx1; tx++)
+				if (!test_depth || (float)minb[2] < depth_buffer.tile_max[ty * grid.tiles_x + tx])
+					grid.bins[ty * grid.tiles_x + tx].push_back(i);
+	}
+}
+
+template<typename T>
+void rasterize_tiles(const TileGrid& grid, const std::vector<ScreenTriangle<T>>& triangles, Framebuffer& framebuffer, DepthBuffer& depth_buffer)
+{
+	//tiles never share pixels, so every tile can be drawn independently
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int t = 0; t < (int)grid.tiles.size(); t++)
+	{
+		auto& tile = grid.tiles[t];
+		for (int i : grid.bins[t])
+		{
+			auto& tri = triangles[i].tri;
+			if (triangles[i].type == WIREFRAME)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					if (!(triangles[i].edges & (1 << k)))
+						continue;
+					auto& a = tri.v[k], & b = tri.v[(k + 1) % 3];
+					clip_line(a[0], a[1], b[0], b[1], tri.color[k], tri.color[(k + 1) % 3], framebuffer, grid.width, grid.height, tile);
+				}
+			}
+			else
+			{
+				draw_solid(tri, triangles[i].setup, framebuffer, depth_buffer, tile);
+			}
+		}
+	}
+}
+
+template std::pair<vec4, vec4> get_triangle_bounds(const BasicTriangle<double>&);
+template std::pair<vec4f, vec4f> get_triangle_bounds(const BasicTriangle<float>&);
+template bool setup_triangle(const BasicTriangle<double>&, TriangleSetup<double>&);
+template bool setup_triangle(const BasicTriangle<float>&, TriangleSetup<float>&);
+template void draw_solid(const BasicTriangle<double>&, const TriangleSetup<double>&, Framebuffer&, DepthBuffer&, const Tile&);
+template void draw_solid(const BasicTriangle<float>&, const TriangleSetup<float>&, Framebuffer&, DepthBuffer&, const Tile&);
+template void bin_triangles(TileGrid&, const std::vector<ScreenTriangle<double>>&, const DepthBuffer&);
+template void bin_triangles(TileGrid&, const std::vector<ScreenTriangle<float>>&, const DepthBuffer&);
+template void rasterize_tiles(const TileGrid&, const std::vector<ScreenTriangle<double>>&, Framebuffer&, DepthBuffer&);
+template void rasterize_tiles(const TileGrid&, const std::vector<ScreenTriangle<float>>&, Framebuffer&, DepthBuffer&);
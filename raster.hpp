@@ -0,0 +1,104 @@
+#ifndef __RASTER_H__
+#define __RASTER_H__
+
+#include <vector>
+#include <utility>
+#include "geometry.hpp"
+#include "framebuffer.hpp"
+#include "clip.hpp"
+
+#define TILE_SIZE 64
+#define BLOCK_SIZE 8
+#define RASTER_BATCH_MIN 4096
+#define RASTER_BATCH_MAX 65536
+#define SUBPIXEL_BITS 8
+#define SUBPIXEL_SCALE (1 << SUBPIXEL_BITS)
+#define RASTER_MAX_SIZE 16384 // largest framebuffer width and height
+// pixels from the origin that a clipped vertex can reach, plus one for vertices
+// clipped onto the guard band that round past it; triangles past it are not set up
+#define SUBPIXEL_LIMIT (RASTER_MAX_SIZE + CLIP_GUARD_BAND + 1)
+
+// Setup and rasterization run in double or in float, chosen per render by T;
+// the float path halves the size of every triangle and vertex in flight.
+
+// barycentric coordinate as a linear function of the pixel: a * x + b * y + c
+template<typename T>
+struct EdgeFunction
+{
+    T a, b, c;
+};
+
+// Coverage of whole pixels by an edge, a * x + b * y + c >= 0 inside. Exact
+// for vertices snapped to 1 / SUBPIXEL_SCALE; c carries the top-left bias, so
+// that a pixel on an edge shared by two triangles belongs to exactly one.
+// Within SUBPIXEL_LIMIT the values stay below 2^49.
+struct FixedEdge
+{
+    int64_t a, b, c;
+};
+
+template<typename T>
+struct TriangleSetup
+{
+    EdgeFunction<T> alpha, beta, gamma; // of the snapped vertices, for interpolation only
+    EdgeFunction<T> depth;
+    FixedEdge edges[3];                 // in the order of alpha, beta and gamma
+    int min_x, min_y, max_x, max_y;     // pixels the snapped triangle may cover, inclusive
+};
+
+template<typename T>
+struct ScreenTriangle
+{
+    BasicTriangle<T> tri;
+    TriangleSetup<T> setup;
+    RenderType type;
+    bool visible;
+    uint8_t edges; // wireframe edges to draw, bit k for v[k] to v[k + 1]; clipping adds edges that are not
+};
+
+// row-major like the framebuffer, so a row span is contiguous in both.
+// block_max and tile_max form a max-depth pyramid over BLOCK_SIZE blocks and
+// TILE_SIZE tiles; they are conservative, never closer than any depth below them.
+struct DepthBuffer
+{
+    int width, height;
+    int blocks_x, blocks_y;
+    int tiles_x, tiles_y;
+    std::vector<float> depth;
+    std::vector<float> block_max;
+    std::vector<float> tile_max;
+
+    DepthBuffer(int width, int height);
+    float* row(int y) { return depth.data() + (size_t)y * width; }
+    float& block(int x, int y) { return block_max[(y / BLOCK_SIZE) * blocks_x + x / BLOCK_SIZE]; }
+    float& tile(int x, int y) { return tile_max[(y / TILE_SIZE) * tiles_x + x / TILE_SIZE]; }
+    void update_tile(const Tile& tile);
+    bool is_occluded(double min_x, double min_y, double max_x, double max_y, double min_z) const;
+};
+
+struct TileGrid
+{
+    int width, height;
+    int tiles_x, tiles_y;
+    std::vector<Tile> tiles;
+    std::vector<std::vector<int>> bins;
+
+    TileGrid(int width, int height);
+};
+
+// fills row y over [x, x_end) where the three edge functions starting at coverage are non-negative
+// and the depth interpolated from the barycentrics (alpha, beta, gamma) at x is closer than depth_row;
+// coverage = NULL skips the edge test
+template<typename T>
+using SolidSpanFunction = void (*)(Framebuffer& framebuffer, float* depth_row, int x, int x_end, int y, T alpha, T beta, T gamma, const int64_t* coverage, const TriangleSetup<T>& setup, const BasicTriangle<T>& tri);
+
+// instantiated for float and double
+template<typename T> SolidSpanFunction<T> get_solid_span_function();
+template<typename T> std::pair<basic_vec4<T>, basic_vec4<T>> get_triangle_bounds(const BasicTriangle<T>& tri);
+template<typename T> bool setup_triangle(const BasicTriangle<T>& tri, TriangleSetup<T>& setup);
+template<typename T> void draw_solid(const BasicTriangle<T>& tri, const TriangleSetup<T>& setup, Framebuffer& framebuffer, DepthBuffer& depth_buffer, const Tile& tile);
+// solid triangles are left out of tiles whose depth they cannot pass
+template<typename T> void bin_triangles(TileGrid& grid, const std::vector<ScreenTriangle<T>>& triangles, const DepthBuffer& depth_buffer);
+template<typename T> void rasterize_tiles(const TileGrid& grid, const std::vector<ScreenTriangle<T>>& triangles, Framebuffer& framebuffer, DepthBuffer& depth_buffer);
+
+#endif
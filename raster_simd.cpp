@@ -0,0 +1,263 @@
+#include "raster.hpp"
+
+// Rows are contiguous in the framebuffer, so the kernels walk x in blocks of
+// 8 (AVX2) or 16 (AVX-512) pixels. Coverage comes from the integer edge
+// functions of the setup, stepped in int64 lanes, so every path covers the
+// same pixels in either precision. The barycentrics only interpolate depth
+// and color; depth is tested before any color is interpolated.
+
+template<typename T>
+static void draw_span_scalar(Framebuffer& framebuffer, float* depth_row, int x, int x_end, int y, T alpha, T beta, T gamma, const int64_t* coverage, const TriangleSetup<T>& setup, const BasicTriangle<T>& tri)
+{
+	T z = alpha * tri.v[0][2] + beta * tri.v[1][2] + gamma * tri.v[2][2];
+	int64_t e[3] = {};
+	if (coverage != NULL)
+		std::copy(coverage, coverage + 3, e);
+
+	for (; x < x_end; x++)
+	{
+		bool inside = coverage == NULL || (e[0] >= 0 && e[1] >= 0 && e[2] >= 0);
+		if (inside && (float)z < depth_row[x])
+		{
+			depth_row[x] = z;
+			framebuffer.set_pixel(x, y, alpha * tri.color[0] + beta * tri.color[1] + gamma * tri.color[2]);
+		}
+		alpha += setup.alpha.a, beta += setup.beta.a, gamma += setup.gamma.a;
+		z += setup.depth.a;
+		for (int k = 0; k < 3; k++)
+			e[k] += setup.edges[k].a;
+	}
+}
+
+template<typename T>
+__attribute__((target("avx2,fma")))
+static inline __m256 interpolate8(__m256 alpha, __m256 beta, __m256 gamma, const BasicTriangle<T>& tri, int channel)
+{
+	__m256 value = _mm256_mul_ps(alpha, _mm256_set1_ps(tri.color[0][channel]));
+	value = _mm256_fmadd_ps(beta, _mm256_set1_ps(tri.color[1][channel]), value);
+	return _mm256_fmadd_ps(gamma, _mm256_set1_ps(tri.color[2][channel]), value);
+}
+
+__attribute__((target("avx2,fma,f16c")))
+static inline void store_pixels8(Framebuffer& framebuffer, int x, int y, __m256 r, __m256 g, __m256 b, __m256 a, __m256 inside)
+{
+	if (framebuffer.format == RGBA8)
+	{
+		//same clamp-and-truncate as clamp_pixel_value
+		const __m256 lo = _mm256_setzero_ps(), hi = _mm256_set1_ps(255);
+		__m256i ri = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(r, lo), hi));
+		__m256i gi = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(g, lo), hi));
+		__m256i bi = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(b, lo), hi));
+		__m256i ai = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(a, lo), hi));
+		__m256i packed = _mm256_or_si256(_mm256_or_si256(ri, _mm256_slli_epi32(gi, 8)),
+			_mm256_or_si256(_mm256_slli_epi32(bi, 16), _mm256_slli_epi32(ai, 24)));
+		_mm256_maskstore_epi32((int*)(framebuffer.row(y) + x * 4), _mm256_castps_si256(inside), packed);
+		return;
+	}
+
+	__m256 rg_lo = _mm256_unpacklo_ps(r, g), rg_hi = _mm256_unpackhi_ps(r, g);
+	__m256 ba_lo = _mm256_unpacklo_ps(b, a), ba_hi = _mm256_unpackhi_ps(b, a);
+
+	//pixels[k] holds pixel k in its low half and pixel k + 4 in its high half
+	__m256 pixels[4] = {
+		_mm256_shuffle_ps(rg_lo, ba_lo, _MM_SHUFFLE(1, 0, 1, 0)),
+		_mm256_shuffle_ps(rg_lo, ba_lo, _MM_SHUFFLE(3, 2, 3, 2)),
+		_mm256_shuffle_ps(rg_hi, ba_hi, _MM_SHUFFLE(1, 0, 1, 0)),
+		_mm256_shuffle_ps(rg_hi, ba_hi, _MM_SHUFFLE(3, 2, 3, 2))
+	};
+
+	unsigned mask = _mm256_movemask_ps(inside);
+	int size = Framebuffer::pixel_size(framebuffer.format);
+	uint8_t* dst = framebuffer.row(y) + x * size;
+	for (int k = 0; k < 4; k++)
+	{
+		__m128 pixel_lo = _mm256_castps256_ps128(pixels[k]), pixel_hi = _mm256_extractf128_ps(pixels[k], 1);
+		if (framebuffer.format == RGBA32F)
+		{
+			if (mask & (1u << k))
+				_mm_storeu_ps((float*)(dst + k * size), pixel_lo);
+			if (mask & (1u << (k + 4)))
+				_mm_storeu_ps((float*)(dst + (k + 4) * size), pixel_hi);
+		}
+		else
+		{
+			if (mask & (1u << k))
+				_mm_storel_epi64((__m128i*)(dst + k * size), _mm_cvtps_ph(pixel_lo, _MM_FROUND_TO_NEAREST_INT));
+			if (mask & (1u << (k + 4)))
+				_mm_storel_epi64((__m128i*)(dst + (k + 4) * size), _mm_cvtps_ph(pixel_hi, _MM_FROUND_TO_NEAREST_INT));
+		}
+	}
+}
+
+__attribute__((target("avx2")))
+static inline __m256 mask_to_vector8(unsigned mask)
+{
+	const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(mask), bits), bits));
+}
+
+//bit k is set when pixel k of the block is on the inside of all three edges, e holds the values at the
+//first pixel and offsets the steps to pixels 0 - 3 and 4 - 7 of every edge
+__attribute__((target("avx2")))
+static inline unsigned cover8(const int64_t* e, const __m256i (*offsets)[2])
+{
+	const __m256i none = _mm256_set1_epi64x(-1);
+	__m256i lo = none, hi = none;
+	for (int k = 0; k < 3; k++)
+	{
+		__m256i base = _mm256_set1_epi64x(e[k]);
+		lo = _mm256_and_si256(lo, _mm256_cmpgt_epi64(_mm256_add_epi64(base, offsets[k][0]), none));
+		hi = _mm256_and_si256(hi, _mm256_cmpgt_epi64(_mm256_add_epi64(base, offsets[k][1]), none));
+	}
+	return _mm256_movemask_pd(_mm256_castsi256_pd(lo)) | _mm256_movemask_pd(_mm256_castsi256_pd(hi)) << 4;
+}
+
+template<typename T>
+__attribute__((target("avx2,fma,f16c")))
+static void draw_span_avx2(Framebuffer& framebuffer, float* depth_row, int x, int x_end, int y, T alpha, T beta, T gamma, const int64_t* coverage, const TriangleSetup<T>& setup, const BasicTriangle<T>& tri)
+{
+	const __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256 da = _mm256_set1_ps(setup.alpha.a), db = _mm256_set1_ps(setup.beta.a), dg = _mm256_set1_ps(setup.gamma.a);
+	const __m256 dz = _mm256_set1_ps(setup.depth.a);
+	T z0 = tri.v[0][2], z1 = tri.v[1][2], z2 = tri.v[2][2];
+	const int x_start = x;
+
+	__m256i offsets[3][2];
+	for (int k = 0; k < 3 && coverage != NULL; k++)
+	{
+		int64_t a = setup.edges[k].a;
+		offsets[k][0] = _mm256_setr_epi64x(0, a, 2 * a, 3 * a);
+		offsets[k][1] = _mm256_setr_epi64x(4 * a, 5 * a, 6 * a, 7 * a);
+	}
+
+	for (; x < x_end; x += 8)
+	{
+		__m256 a = _mm256_fmadd_ps(lanes, da, _mm256_set1_ps(alpha));
+		__m256 b = _mm256_fmadd_ps(lanes, db, _mm256_set1_ps(beta));
+		__m256 g = _mm256_fmadd_ps(lanes, dg, _mm256_set1_ps(gamma));
+		__m256 z = _mm256_fmadd_ps(lanes, dz, _mm256_set1_ps(alpha * z0 + beta * z1 + gamma * z2));
+		alpha += 8 * setup.alpha.a, beta += 8 * setup.beta.a, gamma += 8 * setup.gamma.a;
+
+		__m256 inside = _mm256_cmp_ps(lanes, _mm256_set1_ps(x_end - x), _CMP_LT_OQ);
+		if (coverage != NULL)
+		{
+			int64_t e[3];
+			for (int k = 0; k < 3; k++)
+				e[k] = coverage[k] + (x - x_start) * setup.edges[k].a;
+			inside = _mm256_and_ps(inside, mask_to_vector8(cover8(e, offsets)));
+			if (_mm256_movemask_ps(inside) == 0)
+				continue;
+		}
+
+		__m256 stored = _mm256_maskload_ps(depth_row + x, _mm256_castps_si256(inside));
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(z, stored, _CMP_LT_OQ));
+		if (_mm256_movemask_ps(inside) == 0)
+			continue;
+		_mm256_maskstore_ps(depth_row + x, _mm256_castps_si256(inside), z);
+
+		store_pixels8(framebuffer, x, y,
+			interpolate8(a, b, g, tri, 0), interpolate8(a, b, g, tri, 1),
+			interpolate8(a, b, g, tri, 2), interpolate8(a, b, g, tri, 3), inside);
+	}
+}
+
+template<typename T>
+__attribute__((target("avx512f,avx2,fma")))
+static inline __m512 interpolate16(__m512 alpha, __m512 beta, __m512 gamma, const BasicTriangle<T>& tri, int channel)
+{
+	__m512 value = _mm512_mul_ps(alpha, _mm512_set1_ps(tri.color[0][channel]));
+	value = _mm512_fmadd_ps(beta, _mm512_set1_ps(tri.color[1][channel]), value);
+	return _mm512_fmadd_ps(gamma, _mm512_set1_ps(tri.color[2][channel]), value);
+}
+
+//masked extracts with a zero source, the plain ones start from an undefined register that GCC warns about
+__attribute__((target("avx512f,avx2,fma")))
+static inline __m256 lower_half(__m512 v)
+{
+	return _mm256_castpd_ps(_mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xFF, _mm512_castps_pd(v), 0));
+}
+
+__attribute__((target("avx512f,avx2,fma")))
+static inline __m256 upper_half(__m512 v)
+{
+	return _mm256_castpd_ps(_mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xFF, _mm512_castps_pd(v), 1));
+}
+
+template<typename T>
+__attribute__((target("avx512f,avx2,fma,f16c")))
+static void draw_span_avx512(Framebuffer& framebuffer, float* depth_row, int x, int x_end, int y, T alpha, T beta, T gamma, const int64_t* coverage, const TriangleSetup<T>& setup, const BasicTriangle<T>& tri)
+{
+	const __m512 lanes = _mm512_setr_ps(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m512 zero = _mm512_setzero_ps();
+	const __m512 da = _mm512_set1_ps(setup.alpha.a), db = _mm512_set1_ps(setup.beta.a), dg = _mm512_set1_ps(setup.gamma.a);
+	const __m512 dz = _mm512_set1_ps(setup.depth.a);
+	T z0 = tri.v[0][2], z1 = tri.v[1][2], z2 = tri.v[2][2];
+	const int x_start = x;
+
+	//steps of every edge to pixels 0 - 7 and 8 - 15 of a block
+	const __m512i lanes_lo = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7), lanes_hi = _mm512_setr_epi64(8, 9, 10, 11, 12, 13, 14, 15);
+	__m512i offsets[3][2];
+	for (int k = 0; k < 3 && coverage != NULL; k++)
+	{
+		__m512i a = _mm512_set1_epi64(setup.edges[k].a);
+		offsets[k][0] = _mm512_mullox_epi64(a, lanes_lo);
+		offsets[k][1] = _mm512_mullox_epi64(a, lanes_hi);
+	}
+
+	for (; x < x_end; x += 16)
+	{
+		__m512 a = _mm512_fmadd_ps(lanes, da, _mm512_set1_ps(alpha));
+		__m512 b = _mm512_fmadd_ps(lanes, db, _mm512_set1_ps(beta));
+		__m512 g = _mm512_fmadd_ps(lanes, dg, _mm512_set1_ps(gamma));
+		__m512 z = _mm512_fmadd_ps(lanes, dz, _mm512_set1_ps(alpha * z0 + beta * z1 + gamma * z2));
+		alpha += 16 * setup.alpha.a, beta += 16 * setup.beta.a, gamma += 16 * setup.gamma.a;
+
+		__mmask16 inside = _mm512_cmp_ps_mask(lanes, _mm512_set1_ps(x_end - x), _CMP_LT_OQ);
+		if (coverage != NULL)
+		{
+			__mmask8 lo = 0xFF, hi = 0xFF;
+			for (int k = 0; k < 3; k++)
+			{
+				__m512i e = _mm512_set1_epi64(coverage[k] + (x - x_start) * setup.edges[k].a);
+				lo = _mm512_mask_cmpge_epi64_mask(lo, _mm512_add_epi64(e, offsets[k][0]), _mm512_setzero_si512());
+				hi = _mm512_mask_cmpge_epi64_mask(hi, _mm512_add_epi64(e, offsets[k][1]), _mm512_setzero_si512());
+			}
+			inside &= lo | hi << 8;
+			if (inside == 0)
+				continue;
+		}
+
+		__m512 stored = _mm512_mask_loadu_ps(zero, inside, depth_row + x);
+		inside = _mm512_mask_cmp_ps_mask(inside, z, stored, _CMP_LT_OQ);
+		if (inside == 0)
+			continue;
+		_mm512_mask_storeu_ps(depth_row + x, inside, z);
+
+		__m512 r = interpolate16(a, b, g, tri, 0), gr = interpolate16(a, b, g, tri, 1);
+		__m512 bl = interpolate16(a, b, g, tri, 2), al = interpolate16(a, b, g, tri, 3);
+
+		//the 512-bit registers are stored as two 8-pixel halves
+		if (inside & 0xFF)
+			store_pixels8(framebuffer, x, y,
+				lower_half(r), lower_half(gr), lower_half(bl), lower_half(al), mask_to_vector8(inside & 0xFF));
+		if (inside >> 8)
+			store_pixels8(framebuffer, x + 8, y,
+				upper_half(r), upper_half(gr), upper_half(bl), upper_half(al), mask_to_vector8(inside >> 8));
+	}
+}
+
+template<typename T>
+SolidSpanFunction<T> get_solid_span_function()
+{
+	__builtin_cpu_init();
+	//the kernels also use avx2 and store half floats through f16c
+	bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c");
+	if (avx2 && __builtin_cpu_supports("avx512f"))
+		return draw_span_avx512<T>;
+	if (avx2)
+		return draw_span_avx2<T>;
+	return draw_span_scalar<T>;
+}
+
+template SolidSpanFunction<double> get_solid_span_function();
+template SolidSpanFunction<float> get_solid_span_function();
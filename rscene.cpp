@@ -0,0 +1,252 @@
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include "rscene.hpp"
+
+static uint64_t align_offset(uint64_t offset)
+{
+	return (offset + RSCENE_ALIGNMENT - 1) & ~(uint64_t)(RSCENE_ALIGNMENT - 1);
+}
+
+static void store_vec4(double* dst, vec4c v)
+{
+	for (int i = 0; i < 4; i++)
+		dst[i] = v[i];
+}
+
+static vec4 load_vec4(const double* src)
+{
+	return vec4{ src[0], src[1], src[2], src[3] };
+}
+
+bool is_rscene(const char* path)
+{
+	char magic[8];
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+		return false;
+
+	bool result = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, RSCENE_MAGIC, sizeof(magic)) == 0;
+	fclose(file);
+	return result;
+}
+
+// sequential writer that zero fills up to the next section offset
+struct RSceneWriter
+{
+	FILE* file;
+	uint64_t position = 0;
+	bool ok = true;
+
+	void write(const void* data, size_t size)
+	{
+		if (size > 0 && fwrite(data, 1, size, file) != size)
+			ok = false;
+		position += size;
+	}
+
+	void seek(uint64_t offset)
+	{
+		static const char zeros[RSCENE_ALIGNMENT] = {};
+		while (position < offset)
+			write(zeros, std::min<uint64_t>(offset - position, sizeof(zeros)));
+	}
+};
+
+bool write_rscene(const Scene& scene, const char* path)
+{
+	RSceneHeader header = {};
+	memcpy(header.magic, RSCENE_MAGIC, sizeof(header.magic));
+	header.version = RSCENE_VERSION;
+	header.byte_order = RSCENE_BYTE_ORDER;
+	header.camera_count = scene.cameras.size();
+	header.mesh_count = scene.meshes.size();
+	header.culling_enabled = scene.culling_enabled;
+	store_vec4(header.background_color, scene.background_color);
+
+	//lay out every section before writing anything
+	uint64_t offset = align_offset(sizeof(header));
+	header.cameras_offset = offset;
+	offset = align_offset(offset + header.camera_count * sizeof(RSceneCamera));
+	header.meshes_offset = offset;
+	offset = align_offset(offset + header.mesh_count * sizeof(RSceneMesh));
+
+	std::vector<RSceneCamera> cameras(scene.cameras.size());
+	for (size_t i = 0; i < scene.cameras.size(); i++)
+	{
+		const Camera& cam = scene.cameras[i];
+		RSceneCamera& out = cameras[i];
+		memset(&out, 0, sizeof(out));
+
+		out.projection_type = cam.projection_type;
+		out.width = cam.width;
+		out.height = cam.height;
+		out.name_length = cam.output_file_name.size();
+		out.name_offset = offset;
+		offset += out.name_length;
+
+		store_vec4(out.pos, cam.pos);
+		store_vec4(out.gaze, cam.gaze);
+		store_vec4(out.u, cam.u);
+		store_vec4(out.v, cam.v);
+		store_vec4(out.w, cam.w);
+		out.left = cam.left;
+		out.right = cam.right;
+		out.bottom = cam.bottom;
+		out.top = cam.top;
+		out.near = cam.near;
+		out.far = cam.far;
+	}
+	offset = align_offset(offset);
+
+	std::vector<RSceneMesh> meshes(scene.meshes.size());
+	for (size_t i = 0; i < scene.meshes.size(); i++)
+	{
+		const Mesh& mesh = scene.meshes[i];
+		RSceneMesh& out = meshes[i];
+		memset(&out, 0, sizeof(out));
+
+		out.type = mesh.type;
+		out.vertex_count = mesh.positions.size();
+		out.index_count = mesh.indices.size();
+		out.positions_offset = offset;
+		offset = align_offset(offset + out.vertex_count * sizeof(vec4));
+		out.colors_offset = offset;
+		offset = align_offset(offset + out.vertex_count * sizeof(vec4));
+		out.indices_offset = offset;
+		offset = align_offset(offset + out.index_count * sizeof(uint32_t));
+		out.face_planes_offset = offset;
+		offset = align_offset(offset + mesh.face_planes.size() * sizeof(double));
+		out.meshlets_offset = offset;
+		offset = align_offset(offset + 2 * mesh.meshlet_spheres.size() * sizeof(vec4));
+		store_vec4(out.bounds_min, mesh.bounds_min);
+		store_vec4(out.bounds_max, mesh.bounds_max);
+		store_vec4(out.bounds_sphere, mesh.bounds_sphere);
+	}
+	header.file_size = offset;
+
+	RSceneWriter writer;
+	writer.file = fopen(path, "wb");
+	if (writer.file == NULL)
+		return false;
+
+	writer.write(&header, sizeof(header));
+	writer.seek(header.cameras_offset);
+	writer.write(cameras.data(), cameras.size() * sizeof(RSceneCamera));
+	writer.seek(header.meshes_offset);
+	writer.write(meshes.data(), meshes.size() * sizeof(RSceneMesh));
+
+	for (size_t i = 0; i < cameras.size(); i++)
+	{
+		writer.seek(cameras[i].name_offset);
+		writer.write(scene.cameras[i].output_file_name.data(), cameras[i].name_length);
+	}
+
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		const Mesh& mesh = scene.meshes[i];
+		writer.seek(meshes[i].positions_offset);
+		writer.write(mesh.positions.data(), mesh.positions.size() * sizeof(vec4));
+		writer.seek(meshes[i].colors_offset);
+		writer.write(mesh.colors.data(), mesh.colors.size() * sizeof(vec4));
+		writer.seek(meshes[i].indices_offset);
+		writer.write(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+		writer.seek(meshes[i].face_planes_offset);
+		writer.write(mesh.face_planes.data(), mesh.face_planes.size() * sizeof(double));
+		writer.seek(meshes[i].meshlets_offset);
+		writer.write(mesh.meshlet_spheres.data(), mesh.meshlet_spheres.size() * sizeof(vec4));
+		writer.write(mesh.meshlet_cones.data(), mesh.meshlet_cones.size() * sizeof(vec4));
+	}
+	writer.seek(header.file_size);
+
+	if (fclose(writer.file) != 0)
+		writer.ok = false;
+	return writer.ok;
+}
+
+// count elements of size bytes at offset lie within the file and are aligned for in place use
+static bool is_valid_range(const MappedFile& file, uint64_t offset, uint64_t count, uint64_t size)
+{
+	return offset % RSCENE_ALIGNMENT == 0 && offset <= file.size && count <= (file.size - offset) / size;
+}
+
+bool read_rscene(const char* path, Scene& scene)
+{
+	MappedFile& file = scene.compiled;
+	if (!file.open(path) || file.size < sizeof(RSceneHeader))
+		return false;
+
+	const RSceneHeader& header = *(const RSceneHeader*)file.data;
+	if (memcmp(header.magic, RSCENE_MAGIC, sizeof(header.magic)) != 0 || header.version != RSCENE_VERSION
+		|| header.byte_order != RSCENE_BYTE_ORDER || header.file_size != file.size
+		|| !is_valid_range(file, header.cameras_offset, header.camera_count, sizeof(RSceneCamera))
+		|| !is_valid_range(file, header.meshes_offset, header.mesh_count, sizeof(RSceneMesh)))
+		return false;
+
+	scene.background_color = load_vec4(header.background_color);
+	scene.culling_enabled = header.culling_enabled != 0;
+
+	const RSceneCamera* cameras = (const RSceneCamera*)(file.data + header.cameras_offset);
+	scene.cameras.clear();
+	for (uint32_t i = 0; i < header.camera_count; i++)
+	{
+		const RSceneCamera& in = cameras[i];
+		if (in.name_offset > file.size || in.name_length > file.size - in.name_offset)
+			return false;
+
+		Camera cam;
+		cam.projection_type = in.projection_type == ORTHOGRAPHIC ? ORTHOGRAPHIC : PERSPECTIVE;
+		cam.width = in.width;
+		cam.height = in.height;
+		cam.output_file_name.assign((const char*)file.data + in.name_offset, in.name_length);
+		cam.pos = load_vec4(in.pos);
+		cam.gaze = load_vec4(in.gaze);
+		cam.u = load_vec4(in.u);
+		cam.v = load_vec4(in.v);
+		cam.w = load_vec4(in.w);
+		cam.left = in.left;
+		cam.right = in.right;
+		cam.bottom = in.bottom;
+		cam.top = in.top;
+		cam.near = in.near;
+		cam.far = in.far;
+		scene.cameras.push_back(cam);
+	}
+
+	const RSceneMesh* meshes = (const RSceneMesh*)(file.data + header.meshes_offset);
+	scene.meshes.clear();
+	for (uint32_t i = 0; i < header.mesh_count; i++)
+	{
+		const RSceneMesh& in = meshes[i];
+		uint64_t meshlet_count = (in.index_count / 3 + MESHLET_SIZE - 1) / MESHLET_SIZE;
+		if (in.index_count % 3 != 0
+			|| !is_valid_range(file, in.positions_offset, in.vertex_count, sizeof(vec4))
+			|| !is_valid_range(file, in.colors_offset, in.vertex_count, sizeof(vec4))
+			|| !is_valid_range(file, in.indices_offset, in.index_count, sizeof(uint32_t))
+			|| !is_valid_range(file, in.face_planes_offset, in.index_count / 3 * 4, sizeof(double))
+			|| !is_valid_range(file, in.meshlets_offset, 2 * meshlet_count, sizeof(vec4)))
+			return false;
+
+		Mesh mesh;
+		mesh.type = in.type == WIREFRAME ? WIREFRAME : SOLID;
+		mesh.positions = Array<vec4>((const vec4*)(file.data + in.positions_offset), in.vertex_count);
+		mesh.colors = Array<vec4>((const vec4*)(file.data + in.colors_offset), in.vertex_count);
+		mesh.indices = Array<uint32_t>((const uint32_t*)(file.data + in.indices_offset), in.index_count);
+		mesh.face_planes = Array<double>((const double*)(file.data + in.face_planes_offset), in.index_count / 3 * 4);
+		mesh.meshlet_spheres = Array<vec4>((const vec4*)(file.data + in.meshlets_offset), meshlet_count);
+		mesh.meshlet_cones = Array<vec4>((const vec4*)(file.data + in.meshlets_offset) + meshlet_count, meshlet_count);
+		mesh.bounds_min = load_vec4(in.bounds_min);
+		mesh.bounds_max = load_vec4(in.bounds_max);
+		mesh.bounds_sphere = load_vec4(in.bounds_sphere);
+
+		//the renderer indexes the vertex arrays without checks
+		for (uint32_t index : mesh.indices)
+			if (index >= in.vertex_count)
+				return false;
+
+		scene.meshes.push_back(std::move(mesh));
+	}
+
+	return true;
+}
@@ -0,0 +1,62 @@
+#ifndef __RSCENE_H__
+#define __RSCENE_H__
+
+#include <cstdint>
+#include "Scene.h"
+
+// Compiled scene file. All sections start at RSCENE_ALIGNMENT aligned offsets
+// and mesh arrays are stored in the same layout Mesh uses in memory, so a
+// mapped file is rendered from in place. Files are written in host byte
+// order; byte_order tells a reader on another architecture to reject them.
+
+#define RSCENE_MAGIC "RSCENE\r\n"
+#define RSCENE_VERSION 4
+#define RSCENE_BYTE_ORDER 0x01020304u
+#define RSCENE_ALIGNMENT 64
+
+struct RSceneHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t camera_count;
+    uint32_t mesh_count;
+    uint32_t culling_enabled;
+    uint32_t reserved;
+    double background_color[4];
+    uint64_t cameras_offset; // RSceneCamera[camera_count]
+    uint64_t meshes_offset;  // RSceneMesh[mesh_count]
+    uint64_t file_size;
+};
+
+struct RSceneCamera
+{
+    uint32_t projection_type;
+    int32_t width, height;
+    uint32_t name_length;
+    uint64_t name_offset; // output file name, not null terminated
+    double pos[4], gaze[4], u[4], v[4], w[4];
+    double left, right, bottom, top, near, far;
+};
+
+struct RSceneMesh
+{
+    uint32_t type;
+    uint32_t vertex_count;
+    uint64_t index_count;
+    uint64_t positions_offset;   // vec4[vertex_count], world space
+    uint64_t colors_offset;      // vec4[vertex_count]
+    uint64_t indices_offset;     // uint32_t[index_count]
+    uint64_t face_planes_offset; // double[4 * index_count / 3], see Mesh::face_planes
+    uint64_t meshlets_offset;    // vec4[meshlet_count] spheres, then vec4[meshlet_count] cones
+    double bounds_min[4], bounds_max[4];
+    double bounds_sphere[4];
+};
+
+// true when path starts with the compiled scene magic
+bool is_rscene(const char* path);
+bool write_rscene(const Scene& scene, const char* path);
+// maps path into scene.compiled and points the meshes of scene at it
+bool read_rscene(const char* path, Scene& scene);
+
+#endif
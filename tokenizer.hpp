@@ -0,0 +1,57 @@
+#ifndef __TOKENIZER_H__
+#define __TOKENIZER_H__
+
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+// In-place number parsing over character ranges. Unlike sscanf this neither
+// copies the input nor consults the locale; numbers are separated by any
+// ASCII whitespace.
+
+inline bool is_whitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+inline const char* skip_whitespace(const char* first, const char* last)
+{
+    while (first != last && is_whitespace(*first))
+        first++;
+    return first;
+}
+
+// parses the number at the start of [first, last) after any whitespace and moves first past it
+template<typename T>
+inline bool parse_number(const char*& first, const char* last, T& value)
+{
+    const char* p = skip_whitespace(first, last);
+    if (p != last && *p == '+')
+        p++;
+
+    auto result = std::from_chars(p, last, value);
+    if (result.ec != std::errc())
+        return false;
+
+    first = result.ptr;
+    return true;
+}
+
+// reads up to count consecutive numbers and returns how many were read, like sscanf
+template<typename T>
+inline int parse_numbers(const char*& first, const char* last, T* values, int count)
+{
+    int i = 0;
+    while (i < count && parse_number(first, last, values[i]))
+        i++;
+    return i;
+}
+
+template<typename T>
+inline int parse_numbers(std::string_view text, T* values, int count)
+{
+    const char* first = text.data();
+    return parse_numbers(first, text.data() + text.size(), values, count);
+}
+
+#endif
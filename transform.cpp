@@ -0,0 +1,184 @@
+#include <algorithm>
+
+#include "transform.hpp"
+
+template<typename T, bool divide>
+static void transform_points_scalar(const basic_mat4<T>& m, const vec4* in, basic_vec4<T>* out, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		basic_vec4<T> p = m * convert_vec4<T>(in[i]);
+		if (divide)
+		{
+			T rcp = 1 / p[3];
+			p *= rcp;
+			p[3] = rcp;
+		}
+		out[i] = p;
+	}
+}
+
+__attribute__((target("avx2,fma")))
+static inline void transpose4(__m256d& a, __m256d& b, __m256d& c, __m256d& d)
+{
+	__m256d t0 = _mm256_unpacklo_pd(a, b); // a0 b0 a2 b2
+	__m256d t1 = _mm256_unpackhi_pd(a, b); // a1 b1 a3 b3
+	__m256d t2 = _mm256_unpacklo_pd(c, d); // c0 d0 c2 d2
+	__m256d t3 = _mm256_unpackhi_pd(c, d); // c1 d1 c3 d3
+	a = _mm256_permute2f128_pd(t0, t2, 0x20);
+	b = _mm256_permute2f128_pd(t1, t3, 0x20);
+	c = _mm256_permute2f128_pd(t0, t2, 0x31);
+	d = _mm256_permute2f128_pd(t1, t3, 0x31);
+}
+
+//two independent 4x4 transposes, one per 128-bit lane
+__attribute__((target("avx2,fma")))
+static inline void transpose4x2(__m256& a, __m256& b, __m256& c, __m256& d)
+{
+	__m256 t0 = _mm256_unpacklo_ps(a, b); // a0 b0 a1 b1
+	__m256 t1 = _mm256_unpackhi_ps(a, b); // a2 b2 a3 b3
+	__m256 t2 = _mm256_unpacklo_ps(c, d); // c0 d0 c1 d1
+	__m256 t3 = _mm256_unpackhi_ps(c, d); // c2 d2 c3 d3
+	a = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	b = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	c = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	d = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+template<bool divide>
+__attribute__((target("avx2,fma")))
+static void transform_points_fma(mat4c& m, const vec4* in, vec4* out, size_t n)
+{
+	__m256d e[4][4];
+	for (int r = 0; r < 4; r++)
+		for (int c = 0; c < 4; c++)
+			e[r][c] = _mm256_set1_pd(m.data[r][c]);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256d x = in[i], y = in[i + 1], z = in[i + 2], w = in[i + 3];
+		transpose4(x, y, z, w);
+
+		__m256d result[4];
+		for (int r = 0; r < 4; r++)
+		{
+			__m256d sum = _mm256_mul_pd(e[r][0], x);
+			sum = _mm256_fmadd_pd(e[r][1], y, sum);
+			sum = _mm256_fmadd_pd(e[r][2], z, sum);
+			result[r] = _mm256_fmadd_pd(e[r][3], w, sum);
+		}
+
+		//one division gives the reciprocal w of all four points
+		if (divide)
+		{
+			__m256d rcp = _mm256_div_pd(_mm256_set1_pd(1.0), result[3]);
+			for (int r = 0; r < 3; r++)
+				result[r] = _mm256_mul_pd(result[r], rcp);
+			result[3] = rcp;
+		}
+
+		transpose4(result[0], result[1], result[2], result[3]);
+		out[i] = result[0];
+		out[i + 1] = result[1];
+		out[i + 2] = result[2];
+		out[i + 3] = result[3];
+	}
+
+	transform_points_scalar<double, divide>(m, in + i, out + i, n - i);
+}
+
+//points k and k + 4 of a group of eight share register k, one per 128-bit lane
+template<bool divide>
+__attribute__((target("avx2,fma")))
+static void transform_points_fma(const mat4f& m, const vec4* in, vec4f* out, size_t n)
+{
+	__m256 e[4][4];
+	for (int r = 0; r < 4; r++)
+		for (int c = 0; c < 4; c++)
+			e[r][c] = _mm256_set1_ps(m.data[r][c]);
+
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 p[4];
+		for (int k = 0; k < 4; k++)
+			p[k] = _mm256_set_m128(_mm256_cvtpd_ps(in[i + k + 4]), _mm256_cvtpd_ps(in[i + k]));
+		transpose4x2(p[0], p[1], p[2], p[3]);
+
+		__m256 result[4];
+		for (int r = 0; r < 4; r++)
+		{
+			__m256 sum = _mm256_mul_ps(e[r][0], p[0]);
+			sum = _mm256_fmadd_ps(e[r][1], p[1], sum);
+			sum = _mm256_fmadd_ps(e[r][2], p[2], sum);
+			result[r] = _mm256_fmadd_ps(e[r][3], p[3], sum);
+		}
+
+		//one division gives the reciprocal w of all eight points
+		if (divide)
+		{
+			__m256 rcp = _mm256_div_ps(_mm256_set1_ps(1.0f), result[3]);
+			for (int r = 0; r < 3; r++)
+				result[r] = _mm256_mul_ps(result[r], rcp);
+			result[3] = rcp;
+		}
+
+		transpose4x2(result[0], result[1], result[2], result[3]);
+		for (int k = 0; k < 4; k++)
+		{
+			out[i + k] = _mm256_castps256_ps128(result[k]);
+			out[i + k + 4] = _mm256_extractf128_ps(result[k], 1);
+		}
+	}
+
+	transform_points_scalar<float, divide>(m, in + i, out + i, n - i);
+}
+
+template<typename T>
+using TransformFunction = void (*)(const basic_mat4<T>&, const vec4*, basic_vec4<T>*, size_t);
+
+template<typename T, bool divide>
+static TransformFunction<T> get_transform_function()
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return transform_points_fma<divide>;
+	return transform_points_scalar<T, divide>;
+}
+
+template<typename T>
+static const TransformFunction<T> transform_kernel = get_transform_function<T, false>();
+template<typename T>
+static const TransformFunction<T> project_kernel = get_transform_function<T, true>();
+
+template<typename T>
+static void run_batches(TransformFunction<T> kernel, const basic_mat4<T>& m, const vec4* in, basic_vec4<T>* out, size_t n)
+{
+	if (n <= TRANSFORM_BATCH_SIZE)
+	{
+		kernel(m, in, out, n);
+		return;
+	}
+
+	#pragma omp parallel for
+	for (long long i = 0; i < (long long)n; i += TRANSFORM_BATCH_SIZE)
+		kernel(m, in + i, out + i, std::min<size_t>(TRANSFORM_BATCH_SIZE, n - i));
+}
+
+template<typename T>
+void transform_points(const basic_mat4<T>& m, const vec4* in, basic_vec4<T>* out, size_t n)
+{
+	run_batches(transform_kernel<T>, m, in, out, n);
+}
+
+template<typename T>
+void project_points(const basic_mat4<T>& m, const vec4* in, basic_vec4<T>* out, size_t n)
+{
+	run_batches(project_kernel<T>, m, in, out, n);
+}
+
+template void transform_points(mat4c&, const vec4*, vec4*, size_t);
+template void transform_points(const mat4f&, const vec4*, vec4f*, size_t);
+template void project_points(mat4c&, const vec4*, vec4*, size_t);
+template void project_points(const mat4f&, const vec4*, vec4f*, size_t);
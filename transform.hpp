@@ -0,0 +1,21 @@
+#ifndef __TRANSFORM_H__
+#define __TRANSFORM_H__
+
+#include <cstddef>
+#include "mat4.hpp"
+
+#define TRANSFORM_BATCH_SIZE 1024 // points per task when a transform is split across threads
+
+// out[i] = m * in[i] for n points, computed and stored in the precision T
+// of m; for T = double in and out may be the same array. Large arrays are
+// split into TRANSFORM_BATCH_SIZE batches across threads. Points are
+// transformed four (double) or eight (float) at a time: each group is
+// transposed so that x, y, z and w of the points share a register and every
+// output component is a chain of FMAs with broadcast matrix entries, without
+// horizontal adds. Float points are narrowed as they are loaded.
+template<typename T> void transform_points(const basic_mat4<T>& m, const vec4* in, basic_vec4<T>* out, size_t n);
+// like transform_points followed by a division of x, y and z by w, done as
+// one reciprocal per group of points; w is replaced by 1 / w
+template<typename T> void project_points(const basic_mat4<T>& m, const vec4* in, basic_vec4<T>* out, size_t n);
+
+#endif
@@ -12,6 +12,14 @@
 
 typedef __m256d vec4;
 typedef const vec4 vec4c;
+typedef __m128 vec4f;
+typedef const vec4f vec4fc;
+
+// vector of four T for T = double or float
+template<typename T> struct vec4_traits;
+template<> struct vec4_traits<double> { typedef vec4 type; };
+template<> struct vec4_traits<float> { typedef vec4f type; };
+template<typename T> using basic_vec4 = typename vec4_traits<T>::type;
 
 typedef const float cfloat;
 
@@ -72,4 +80,17 @@ static inline vec4 max4(vec4c lhs, vec4c rhs) {
    return vec4{fmax(lhs[0], rhs[0]), fmax(lhs[1], rhs[1]), fmax(lhs[2], rhs[2]), fmax(lhs[3], rhs[3])};
 }
 
+static inline vec4f min4(vec4fc lhs, vec4fc rhs) {
+   return vec4f{fminf(lhs[0], rhs[0]), fminf(lhs[1], rhs[1]), fminf(lhs[2], rhs[2]), fminf(lhs[3], rhs[3])};
+}
+
+static inline vec4f max4(vec4fc lhs, vec4fc rhs) {
+   return vec4f{fmaxf(lhs[0], rhs[0]), fmaxf(lhs[1], rhs[1]), fmaxf(lhs[2], rhs[2]), fmaxf(lhs[3], rhs[3])};
+}
+
+// narrows or keeps a double vector
+template<typename T> basic_vec4<T> convert_vec4(vec4c v);
+template<> inline vec4 convert_vec4<double>(vec4c v) { return v; }
+template<> inline vec4f convert_vec4<float>(vec4c v) { return _mm256_cvtpd_ps(v); }
+
 #endif
@@ -0,0 +1,260 @@
+#include <cstring>
+
+#include "xml_stream.hpp"
+
+static bool is_space(int c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+XMLStream::XMLStream(const char* path) : pos(0), end(0), attribute_count(0), pending_end(false)
+{
+	file = fopen(path, "rb");
+}
+
+XMLStream::~XMLStream()
+{
+	if (file != NULL)
+		fclose(file);
+}
+
+int XMLStream::peek()
+{
+	if (pos == end)
+	{
+		pos = 0;
+		end = fread(buffer, 1, sizeof(buffer), file);
+		if (end == 0)
+			return EOF;
+	}
+	return (unsigned char)buffer[pos];
+}
+
+int XMLStream::get()
+{
+	int c = peek();
+	if (c != EOF)
+		pos++;
+	return c;
+}
+
+int XMLStream::skip_whitespace()
+{
+	int c;
+	while (is_space(c = peek()))
+		pos++;
+	return c;
+}
+
+void XMLStream::expect(char c)
+{
+	if (get() != c)
+		throw XMLStreamError();
+}
+
+//consumes everything up to and including terminator
+void XMLStream::skip_until(const char* terminator)
+{
+	size_t length = strlen(terminator), matched = 0;
+	while (matched < length)
+	{
+		int c = get();
+		if (c == EOF)
+			throw XMLStreamError();
+
+		if (c == terminator[matched])
+			matched++;
+		else
+			matched = (c == terminator[0]) ? 1 : 0;
+	}
+}
+
+void XMLStream::read_name(std::string& out)
+{
+	out.clear();
+	int c;
+	while ((c = peek()) != EOF && !is_space(c) && c != '>' && c != '/' && c != '=')
+	{
+		out += (char)c;
+		pos++;
+	}
+	if (out.empty())
+		throw XMLStreamError();
+}
+
+void XMLStream::read_start_tag()
+{
+	read_name(token);
+	attribute_count = 0;
+
+	while (true)
+	{
+		int c = skip_whitespace();
+		if (c == '/')
+		{
+			pos++;
+			expect('>');
+			pending_end = true;
+			return;
+		}
+		if (c == '>')
+		{
+			pos++;
+			return;
+		}
+
+		//strings of earlier elements are reused to keep their capacity
+		if (attribute_count == attributes.size())
+			attributes.emplace_back();
+		auto& attribute = attributes[attribute_count++];
+
+		read_name(attribute.first);
+		skip_whitespace();
+		expect('=');
+		int quote = skip_whitespace();
+		if (quote != '"' && quote != '\'')
+			throw XMLStreamError();
+		pos++;
+
+		//copied a buffer at a time, a value may span a refill
+		attribute.second.clear();
+		while (true)
+		{
+			if (peek() == EOF)
+				throw XMLStreamError();
+
+			const char* first = buffer + pos;
+			const char* last = (const char*)memchr(first, quote, end - pos);
+			size_t length = (last != NULL ? last : buffer + end) - first;
+			attribute.second.append(first, length);
+			pos += length;
+
+			if (last != NULL)
+			{
+				pos++;
+				break;
+			}
+		}
+		if (attribute.second.find_first_of("&<") != std::string::npos)
+			throw XMLStreamError();
+	}
+}
+
+//tokens that lie within the buffer are returned in place, only ones crossing a refill are copied
+void XMLStream::read_text()
+{
+	size_t first = pos;
+	while (pos < end && !is_space(buffer[pos]) && buffer[pos] != '<')
+		pos++;
+
+	if (pos < end)
+	{
+		text_token = std::string_view(buffer + first, pos - first);
+	}
+	else
+	{
+		text_buffer.assign(buffer + first, pos - first);
+		int c;
+		while ((c = peek()) != EOF && !is_space(c) && c != '<')
+		{
+			text_buffer += (char)c;
+			pos++;
+		}
+		text_token = text_buffer;
+	}
+
+	if (text_token.find('&') != std::string_view::npos)
+		throw XMLStreamError();
+}
+
+XMLStream::Event XMLStream::next()
+{
+	if (pending_end)
+	{
+		pending_end = false;
+		return END;
+	}
+
+	while (true)
+	{
+		int c = skip_whitespace();
+		if (c == EOF)
+			return DONE;
+
+		if (c != '<')
+		{
+			read_text();
+			return TEXT;
+		}
+
+		pos++;
+		c = peek();
+		if (c == '/')
+		{
+			pos++;
+			read_name(token);
+			skip_whitespace();
+			expect('>');
+			return END;
+		}
+		if (c == '?')
+		{
+			skip_until("?>");
+			continue;
+		}
+		if (c == '!')
+		{
+			pos++;
+			expect('-');
+			expect('-');
+			skip_until("-->");
+			continue;
+		}
+
+		read_start_tag();
+		return START;
+	}
+}
+
+//copied a buffer at a time, next() then returns the markup that ended the text
+bool XMLStream::read_raw_text(std::string& out, size_t size)
+{
+	if (pending_end)
+		return false;
+
+	size_t start = out.size();
+	while (peek() != EOF && buffer[pos] != '<')
+	{
+		const char* first = buffer + pos;
+		const char* last = (const char*)memchr(first, '<', end - pos);
+		if (last == NULL)
+			last = buffer + end;
+
+		bool full = false;
+		if (out.size() - start >= size)
+		{
+			const char* line = (const char*)memchr(first, '\n', last - first);
+			if (line != NULL)
+			{
+				last = line + 1;
+				full = true;
+			}
+		}
+
+		if (memchr(first, '&', last - first) != NULL)
+			throw XMLStreamError();
+		out.append(first, last - first);
+		pos += last - first;
+		if (full)
+			break;
+	}
+	return out.size() > start;
+}
+
+const char* XMLStream::attribute(const char* key) const
+{
+	for (size_t i = 0; i < attribute_count; i++)
+		if (attributes[i].first == key)
+			return attributes[i].second.c_str();
+	return NULL;
+}
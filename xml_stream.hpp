@@ -0,0 +1,69 @@
+#ifndef __XML_STREAM_H__
+#define __XML_STREAM_H__
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+
+#define XML_STREAM_BUFFER_SIZE (1 << 16)
+
+// thrown for malformed input and for constructs the stream does not handle
+// (entities, CDATA, DOCTYPE); callers fall back to tinyxml2 for those
+class XMLStreamError {};
+
+// Pull parser reading the file through a fixed size buffer. Text content is
+// returned one whitespace separated token at a time, or in raw chunks cut at
+// line breaks for long elements such as <Faces> that are parsed elsewhere.
+class XMLStream
+{
+public:
+    enum Event
+    {
+        START, // element opened, name() and attribute() are valid
+        END,   // element closed, name() is valid
+        TEXT,  // text() holds the next token of the element text
+        DONE
+    };
+
+    XMLStream(const char* path);
+    ~XMLStream();
+    XMLStream(const XMLStream&) = delete;
+    XMLStream& operator=(const XMLStream&) = delete;
+
+    bool is_open() const { return file != NULL; }
+    Event next();
+
+    // name of the last opened or closed element, kept across TEXT events
+    const std::string& name() const { return token; }
+    // token of the last TEXT event, valid until the next call to next()
+    std::string_view text() const { return text_token; }
+    // value of attribute key of the last opened element, NULL when missing
+    const char* attribute(const char* key) const;
+    // appends the text up to the next markup to out, ending after the first
+    // line break once size bytes are read; false when no text is left
+    bool read_raw_text(std::string& out, size_t size);
+
+private:
+    FILE* file;
+    char buffer[XML_STREAM_BUFFER_SIZE];
+    size_t pos, end;
+    std::string token;
+    std::string text_buffer; // holds a text token that crosses a refill
+    std::string_view text_token;
+    std::vector<std::pair<std::string, std::string>> attributes;
+    size_t attribute_count;
+    bool pending_end; // last element was self-closing
+
+    int peek();
+    int get();
+    int skip_whitespace();
+    void expect(char c);
+    void skip_until(const char* terminator);
+    void read_name(std::string& out);
+    void read_start_tag();
+    void read_text();
+};
+
+#endif